@@ -2,209 +2,281 @@
 
 #include "SFML/Graphics.hpp"
 #include "block.h"
+#include "bodies.h"
+#include "collision.h"
 #include "constants.h"
+#include "fixed.h"
 #include "player.h"
 #include "grid.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
 #include <set>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
 
 /**
- * Ball class
+ * Build ball velocities for each hit offset along the paddle
+ * Offset maps linearly to [-pi/2, pi/2] from straight up, clamped to 4/10 pi
+ * either side. Uses the integer series from fixed.h so the table is built
+ * at compile time.
+ * @return velocity per offset step, left edge first
  */
-class Ball {
+constexpr std::array<sf::Vector2f, PADDLE_STEPS> BuildPaddleDeflections() {
+  std::array<sf::Vector2f, PADDLE_STEPS> table{};
+  const int64_t limit = 4 * PADDLE_STEPS / 10;
+  const double scale = static_cast<double>(BALL_SPEED) / (int64_t(1) << 30);
+  for (int i = 0; i < PADDLE_STEPS; i++) {
+    int64_t step = std::clamp<int64_t>(i - PADDLE_STEPS / 2, -limit, limit);
+    int64_t angle = PI_Q30 * step / (PADDLE_STEPS - 1);
+    table[i] = {static_cast<float>(SinQ30(angle) * scale), static_cast<float>(-CosQ30(angle) * scale)};
+  }
+  return table;
+}
+
+constexpr std::array<sf::Vector2f, PADDLE_STEPS> PADDLE_DEFLECTIONS = BuildPaddleDeflections();
+
+/// 1 / sqrt(2), corner normal when the ball centre sits exactly on the corner
+constexpr float INV_SQRT2 = 0.707106781f;
+
+/// rotation by a third of a turn, cos(2pi/3) and sin(2pi/3)
+constexpr float THIRD_TURN_COS = -0.5f;
+constexpr float THIRD_TURN_SIN = 0.866025404f;
+
+/**
+ * Scalar operations for float balls
+ * BasicBall does all of its arithmetic through a scalar policy like this
+ * one, so both physics modes share one copy of the collision code.
+ */
+struct float_scalar {
+  typedef float value;          /// coordinate type
+  typedef sf::Vector2f vec;     /// vector type
+  typedef float wide;           /// type of squared lengths
+
+  static constexpr value CORNER_DIAGONAL = INV_SQRT2;
+  static constexpr value THIRD_TURN_COS = ::THIRD_TURN_COS;
+  static constexpr value THIRD_TURN_SIN = ::THIRD_TURN_SIN;
+
+  static value FromInt(int number) { return static_cast<float>(number); }
+  static value FromFloat(float number) { return number; }
+  static vec FromFixed(fixed_vec v) { return ToFloat(v); }
+  static fixed_vec ToFixed(vec v) { return {::ToFixed(v.x), ::ToFixed(v.y)}; }
+  static sf::Vector2f ToVector(vec v) { return v; }
+  static value Mul(value a, value b) { return a * b; }
+  static wide LengthSq(vec v) { return v.x * v.x + v.y * v.y; }
+  static value Length(wide length_sq) { return std::sqrt(length_sq); }
+  static vec Direction(vec v, value length) { return v / length; }
+  static value Sign(value number) { return std::copysign(1.0f, number); }
+  static int Floor(value number) { return static_cast<int>(std::floor(number)); }
+  static int CellOf(value coordinate) { return Floor(coordinate / BLOCK_SIZE_TOTAL); }
+  static vec PaddleVelocity(int step) { return PADDLE_DEFLECTIONS[step]; }
+};
+
+/**
+ * Ball class template
+ * Motion is kept purely as a velocity vector, bounces flip or reflect it
+ * and the paddle picks a new one from a table. All arithmetic goes through
+ * the scalar policy, so the float and fixed point balls share every
+ * physics rule and only differ in how numbers are stored and rounded.
+ * @tparam Scalar scalar policy, see float_scalar and fixed_scalar
+ */
+template <typename Scalar>
+class BasicBall {
 private:
-  sf::CircleShape m_shape;  /// Shape that represents the ball
-  sf::Vector2f m_position;  /// Position of the ball
-  sf::Vector2f m_velocity;  /// Velocity of the ball
-  double m_angle;           /// Angle at which the ball moves
+  typedef typename Scalar::value value;
+  typedef typename Scalar::vec vec;
+  typedef typename Scalar::wide wide;
+
+  vec m_position;  /// Position of the ball
+  vec m_velocity;  /// Velocity of the ball
 
   /**
-   * Reset ball velocity based on angle
+   * Convert whole number to scalar
+   * @param number number
+   * @return scalar
    */
-  void ResetVelocity() {
-    m_velocity.x = cos(m_angle) * BALL_SPEED;
-    m_velocity.y = sin(m_angle) * BALL_SPEED;
+  static value Int(int number) {
+    return Scalar::FromInt(number);
   }
 
   /**
-   * Reset ball angle based on velocity
+   * Dot product
+   * @param a vector
+   * @param b vector
+   * @return dot product
    */
-  void ResetAngle() {
-    m_angle = atan2(m_velocity.y, m_velocity.x);
+  static value Dot(vec a, vec b) {
+    return Scalar::Mul(a.x, b.x) + Scalar::Mul(a.y, b.y);
   }
 
   /**
-   * Collide with edges of screen and change angle
+   * Reflect velocity through a unit normal if moving against it
+   * @param velocity velocity to reflect relative to
+   * @param normal unit normal
    */
-  void EdgeCollision() {
-    // top edge collision
-    if (m_position.y - BALL_RADIUS <= 0) {
-      m_velocity.y *= -1;
-      ResetAngle();
-    }
-
-    // side edge collision
-    if (m_position.x - BALL_RADIUS <= 0 ||
-        m_position.x + BALL_RADIUS >= WINDOW_WIDTH) {
-      m_velocity.x *= -1;
-      ResetAngle();
+  void Reflect(vec velocity, vec normal) {
+    value dot = Dot(velocity, normal);
+    if (dot < 0) {
+      m_velocity.x -= 2 * Scalar::Mul(dot, normal.x);
+      m_velocity.y -= 2 * Scalar::Mul(dot, normal.y);
     }
   }
 
   /**
-   * Check for collision with block in grid
-   * @param block block from grid
-   * @return type of collision
+   * Get velocity component pointing along a direction
+   * @param component velocity component
+   * @param direction sign of the result
+   * @return component with its sign set by direction
    */
-  collision_type BlockCollision(const Block &block) const {
-    sf::Vector2f block_pos = block.GetPosition();
-    float dx = abs(block_pos.x - m_position.x);
-    float dy = abs(block_pos.y - m_position.y);
-
-    if (dx > BLOCK_HALF_SIZE_TOTAL + BALL_RADIUS) return collision_type::NONE;
-    if (dy > BLOCK_HALF_SIZE_TOTAL + BALL_RADIUS) return collision_type::NONE;
+  static value Toward(value component, int direction) {
+    return (direction > 0) ? std::abs(component) : -std::abs(component);
+  }
 
-    if (m_position.x <= block_pos.x + BLOCK_HALF_SIZE_TOTAL &&
-        m_position.x >= block_pos.x - BLOCK_HALF_SIZE_TOTAL) {
-      return collision_type::VERTICAL;
+  /**
+   * Correct ball position and velocity after collision with tiles
+   * @param response collision response from table
+   * @param occupied occupancy of the 3x3 neighbourhood
+   * @param ox ball x offset inside its cell
+   * @param oy ball y offset inside its cell
+   */
+  void HandleCollision(const tile_response &response, uint16_t occupied, value ox, value oy) {
+    if (response.corner) {
+      // reflect through the normal from the touched block corner to the ball
+      vec delta = {ox - Int((response.nx > 0) ? 0 : BLOCK_SIZE_TOTAL),
+                   oy - Int((response.ny > 0) ? 0 : BLOCK_SIZE_TOTAL)};
+      wide dist_sq = Scalar::LengthSq(delta);
+      vec normal = (dist_sq > 0) ? Scalar::Direction(delta, Scalar::Length(dist_sq))
+                                 : vec{response.nx * Scalar::CORNER_DIAGONAL, response.ny * Scalar::CORNER_DIAGONAL};
+      Reflect(m_velocity, normal);
+      return;
     }
 
-    if (m_position.y <= block_pos.y + BLOCK_HALF_SIZE_TOTAL &&
-        m_position.y >= block_pos.y - BLOCK_HALF_SIZE_TOTAL) {
-      return collision_type::HORIZONTAL;
+    // mirror the overshoot back out, but never into a block on the far side
+    if (response.nx != 0) {
+      value edge_x = Int((response.nx > 0) ? BALL_RADIUS : BLOCK_SIZE_TOTAL - BALL_RADIUS);
+      value x = 2 * edge_x - ox;
+      uint16_t ahead = (response.nx > 0) ? (TILE_NE | TILE_E | TILE_SE) : (TILE_NW | TILE_W | TILE_SW);
+      if (occupied & ahead & TouchMask(x, oy)) x = Int(BLOCK_SIZE_TOTAL) - edge_x;
+      m_position.x += x - ox;
+      m_velocity.x = Toward(m_velocity.x, response.nx);
+      ox = x;
     }
 
-    double corner_dist = pow(dx - BLOCK_HALF_SIZE_TOTAL, 2) + pow(dy - BLOCK_HALF_SIZE_TOTAL, 2);
-    if (corner_dist <= pow(BALL_RADIUS, 2)) return collision_type::CORNER;
-
-    return collision_type::NONE;
-  }
-
-  /**
-   * Calculate new angle and velocity after corner collision
-   * @param block block from grid
-   */
-  void CalculateCornerCollision(const Block &block) {
-    sf::Vector2f block_pos = block.GetPosition();
-    sf::Vector2f block_to_ball = (m_position - block_pos).normalized();
-    float dot = block_to_ball.dot(m_velocity);
-
-    // reflect through normal vector (block center to ball center)
-    m_velocity -= 2.0f * dot * block_to_ball;
-    ResetAngle();
+    if (response.ny != 0) {
+      value edge_y = Int((response.ny > 0) ? BALL_RADIUS : BLOCK_SIZE_TOTAL - BALL_RADIUS);
+      value y = 2 * edge_y - oy;
+      uint16_t ahead = (response.ny > 0) ? (TILE_SW | TILE_S | TILE_SE) : (TILE_NW | TILE_N | TILE_NE);
+      if (occupied & ahead & TouchMask(ox, y)) y = Int(BLOCK_SIZE_TOTAL) - edge_y;
+      m_position.y += y - oy;
+      m_velocity.y = Toward(m_velocity.y, response.ny);
+    }
   }
 
   /**
-   * Correct ball position after collision
-   * @param collision type of collision
-   * @param block block in collision
+   * Move ball out of the block its centre is inside
+   * Takes the shortest way into a free face neighbour and heads that way;
+   * a ball buried on all four sides turns back the way it came.
+   * @param occupied occupancy of the 3x3 neighbourhood
+   * @param ox ball x offset inside its cell
+   * @param oy ball y offset inside its cell
    */
-  void SnapBall(const collision_type &collision, const Block &block) {
-    sf::Vector2f block_pos = block.GetPosition();
-    if (collision == collision_type::HORIZONTAL) {
-      float edge_x;
-      if (m_position.x < block_pos.x) {
-        edge_x = block_pos.x - BLOCK_HALF_SIZE_TOTAL - BALL_RADIUS;
-      } else {
-        edge_x = block_pos.x + BLOCK_HALF_SIZE_TOTAL + BALL_RADIUS;
+  void PushOut(uint16_t occupied, value ox, value oy) {
+    const tile_exit *best = nullptr;
+    value best_distance = 0;
+    for (const tile_exit &exit : TILE_EXITS) {
+      if (occupied & exit.tile) continue;
+      value inside = (exit.dx < 0) ? ox : (exit.dx > 0) ? Int(BLOCK_SIZE_TOTAL) - ox
+                   : (exit.dy < 0) ? oy : Int(BLOCK_SIZE_TOTAL) - oy;
+      value distance = inside + Int(BALL_RADIUS);
+      if (best == nullptr || distance < best_distance) {
+        best = &exit;
+        best_distance = distance;
       }
-      float dx = edge_x - m_position.x;
-      m_position.x += 2 * dx;
     }
-    if (collision == collision_type::VERTICAL) {
-      float edge_y;
-      if (m_position.y < block_pos.y) {
-        edge_y = block_pos.y - BLOCK_HALF_SIZE_TOTAL - BALL_RADIUS;
-      } else {
-        edge_y = block_pos.y + BLOCK_HALF_SIZE_TOTAL + BALL_RADIUS;
-      }
-      float dy = edge_y - m_position.y;
-      m_position.y += 2 * dy;
-    }
-  }
 
-  /**
-   * Set new velocity/angle based on collision with block
-   * @param collision type of collision
-   * @param block block in collision
-   */
-  void HandleCollision(const collision_type &collision, const Block &block) {
-    switch(collision) {
-      case collision_type::VERTICAL:
-        SnapBall(collision, block);
-        m_velocity.y *= -1;
-        ResetAngle();
-        break;
-      case collision_type::HORIZONTAL:
-        SnapBall(collision, block);
-        m_velocity.x *= -1;
-        ResetAngle();
-        break;
-      case collision_type::CORNER:
-        CalculateCornerCollision(block);
-        break;
-      default:
-        // should be impossible, but IDE throws warning
-        break;
+    if (best == nullptr) {
+      m_velocity = {-m_velocity.x, -m_velocity.y};
+      return;
     }
+    m_position.x += best->dx * best_distance;
+    m_position.y += best->dy * best_distance;
+    if (best->dx != 0) m_velocity.x = Toward(m_velocity.x, best->dx);
+    if (best->dy != 0) m_velocity.y = Toward(m_velocity.y, best->dy);
   }
 
 public:
   /**
    * Default constructor
    */
-  Ball() {
-    m_position = {400, PLAYER_Y - BALL_RADIUS};
-    m_shape.setRadius(BALL_RADIUS);
-    m_shape.setOrigin({BALL_RADIUS, BALL_RADIUS});
-    m_shape.setFillColor(BALL_COLOR);
-    m_shape.setPosition(m_position);
-    m_angle = -M_PI / 2.0f;
-    ResetVelocity();
+  BasicBall() {
+    m_position = {Int(400), Int(PLAYER_Y - BALL_RADIUS)};
+    m_velocity = Scalar::PaddleVelocity(PADDLE_STEPS / 2);
   }
 
   /**
    * Duplication constructor
    * @param pos position
-   * @param angle angle of movement
+   * @param velocity velocity
    */
-  Ball(sf::Vector2f pos, double angle) {
+  BasicBall(vec pos, vec velocity) {
     m_position = pos;
-    m_shape.setRadius(BALL_RADIUS);
-    m_shape.setOrigin({BALL_RADIUS, BALL_RADIUS});
-    m_shape.setFillColor(BALL_COLOR);
-    m_shape.setPosition(m_position);
-    m_angle = angle;
-    ResetVelocity();
+    m_velocity = velocity;
+  }
+
+  /**
+   * Get copy of ball turned a third of a turn
+   * @param clockwise direction to turn
+   * @return turned ball
+   */
+  BasicBall Turned(bool clockwise) const {
+    value s = clockwise ? -Scalar::THIRD_TURN_SIN : Scalar::THIRD_TURN_SIN;
+    vec velocity = {Scalar::Mul(m_velocity.x, Scalar::THIRD_TURN_COS) - Scalar::Mul(m_velocity.y, s),
+                    Scalar::Mul(m_velocity.x, s) + Scalar::Mul(m_velocity.y, Scalar::THIRD_TURN_COS)};
+    return BasicBall(m_position, velocity);
   }
 
   /**
-   * Move ball based on velocity
+   * Move every ball and bounce off the screen edges
+   * Branch free, so GCC and Clang vectorize the loop across fixed point
+   * balls at -O3 (the Release config); GCC's -O2 cost model keeps it scalar
+   * @param balls balls
    */
-  void Move() {
-    m_position.x += m_velocity.x;
-    m_position.y += m_velocity.y;
-    EdgeCollision();
+  static void MoveAll(std::pmr::vector<BasicBall> &balls) {
+    const value left = Int(BALL_RADIUS);
+    const value right = Int(WINDOW_WIDTH - BALL_RADIUS);
+    const value top = Int(BALL_RADIUS);
+    BasicBall *ball = balls.data();
+    size_t count = balls.size();
+    for (size_t i = 0; i < count; i++) {
+      value x = ball[i].m_position.x + ball[i].m_velocity.x;
+      value y = ball[i].m_position.y + ball[i].m_velocity.y;
+      value vx = ball[i].m_velocity.x;
+      value vy = ball[i].m_velocity.y;
+      ball[i].m_position.x = x;
+      ball[i].m_position.y = y;
+      ball[i].m_velocity.x = (x <= left || x >= right) ? -vx : vx;
+      ball[i].m_velocity.y = (y <= top) ? -vy : vy;
+    }
   }
 
   /**
-   * Collision check with player, set velocity
+   * Collision check with player, set velocity from paddle table
    * @param player player
    */
   void PlayerCollision(const Player &player) {
-    sf::Vector2f player_pos = player.GetPosition();
+    value player_x = Scalar::FromFloat(player.GetPosition().x);
+    value player_y = Scalar::FromFloat(player.GetPosition().y);
 
     // TODO: Come up with better collision detection
-    if (m_position.y >= player_pos.y - BALL_RADIUS &&
-        m_position.y <= player_pos.y + BALL_RADIUS) {
-      if (m_position.x > player_pos.x - PLAYER_HALF_WIDTH &&
-          m_position.x < player_pos.x + PLAYER_HALF_WIDTH) {
-        // linear mapping of ball relative to player to [-pi, 0]
-        // then fix range to [-9/10 pi, -1/10 pi]
-        m_angle = M_PI / PLAYER_WIDTH * (m_position.x - player_pos.x) - M_PI / 2.0f;
-        m_angle = std::max(-9 * M_PI / 10.0, std::min(-M_PI / 10.0, m_angle));
-        ResetVelocity();
+    if (m_position.y >= player_y - Int(BALL_RADIUS) &&
+        m_position.y <= player_y + Int(BALL_RADIUS)) {
+      if (m_position.x > player_x - Int(PLAYER_HALF_WIDTH) &&
+          m_position.x < player_x + Int(PLAYER_HALF_WIDTH)) {
+        int step = Scalar::Floor((m_position.x - player_x) * PADDLE_SUBSTEPS) + PADDLE_STEPS / 2;
+        m_velocity = Scalar::PaddleVelocity(std::clamp(step, 0, PADDLE_STEPS - 1));
       }
     }
   }
@@ -212,41 +284,111 @@ public:
   /**
    * Collision check with all blocks in grid
    * @param grid grid of blocks
+   * @param tests incremented by the number of tiles tested
+   * @return number of blocks broken
    */
-  void GridCollision(Grid &grid) {
+  uint32_t GridCollision(Grid &grid, uint32_t &tests) {
+    int cell_x = Scalar::CellOf(m_position.x);
+    int cell_y = Scalar::CellOf(m_position.y);
+
     // narrow search
-    block_map subset = grid.GetSubset(m_position);
-    if (subset.empty()) return;
-
-    // find nearest block
-    Block *nearest;
-    float min_dist = -1;
-    uint32_t nearest_id = 0;
-
-    for (const auto &block : subset) {
-      float dist = (block.second->GetPosition() - m_position).length();
-      if (min_dist == -1 || dist < min_dist) {
-        min_dist = dist;
-        nearest_id = block.first;
-        nearest = block.second.get();
-      }
+    uint16_t occupied = grid.GetNeighbourhood(cell_x, cell_y);
+    if (occupied == 0) return 0;
+    tests += std::popcount(occupied);
+
+    value ox = m_position.x - Int(cell_x * BLOCK_SIZE_TOTAL);
+    value oy = m_position.y - Int(cell_y * BLOCK_SIZE_TOTAL);
+    uint16_t hit = occupied & TouchMask(ox, oy);
+    if (hit == 0) return 0;
+
+    // resolve every contact at once, or escape if pushed inside a block
+    if (hit & TILE_CENTER) {
+      PushOut(occupied, ox, oy);
+    } else {
+      HandleCollision(TILE_RESPONSES[hit], occupied, ox, oy);
     }
 
-    // has collision happened?
-    collision_type collision = BlockCollision(*nearest);
-    if (collision != collision_type::NONE) {
-      HandleCollision(collision, *nearest);
-      if (nearest->GetBreakable()) grid.Remove(nearest_id);
+    uint32_t broken = 0;
+    for (uint16_t bits = hit; bits != 0; bits &= bits - 1) {
+      int tile = std::countr_zero(bits);
+      uint32_t id = grid.GetTileID(cell_x + tile % 3 - 1, cell_y + tile / 3 - 1);
+      if (grid.IsBreakable(id)) {
+        grid.Remove(id);
+        broken++;
+      }
     }
+    return broken;
+  }
+
+  /**
+   * Collision check with moving blocks
+   * Bodies are oriented boxes, so the ball is tested in each body's frame.
+   * Body state is fixed point and converted exactly on the way in.
+   * @param bodies moving blocks
+   * @param tests incremented by the number of bodies tested
+   * @return number of bodies broken
+   */
+  uint32_t BodyCollision(Bodies &bodies, uint32_t &tests) {
+    int64_t hit = -1;
+    const value radius = Int(BALL_RADIUS);
+    tests += bodies.Query(Scalar::ToFixed(m_position), ::ToFixed(BALL_RADIUS), [&](uint32_t index) {
+      const body &item = bodies.Get(index);
+      vec axis = Scalar::FromFixed(item.axis);
+      vec half = Scalar::FromFixed(item.half);
+      vec position = Scalar::FromFixed(item.position);
+      vec perp = {-axis.y, axis.x};
+      vec offset = {m_position.x - position.x, m_position.y - position.y};
+      vec local = {Dot(offset, axis), Dot(offset, perp)};
+      vec delta = {local.x - std::clamp(local.x, -half.x, half.x),
+                   local.y - std::clamp(local.y, -half.y, half.y)};
+      wide dist_sq = Scalar::LengthSq(delta);
+      if (dist_sq > Scalar::LengthSq({radius, 0})) return false;
+
+      // normal in body frame and how far to push the ball out
+      vec normal;
+      value depth;
+      value dist = Scalar::Length(dist_sq);
+      if (dist > 0) {
+        normal = Scalar::Direction(delta, dist);
+        depth = radius - dist;
+      } else {
+        value pen_x = half.x - std::abs(local.x);
+        value pen_y = half.y - std::abs(local.y);
+        if (pen_x < pen_y) {
+          normal = {Scalar::Sign(local.x), 0};
+          depth = pen_x + radius;
+        } else {
+          normal = {0, Scalar::Sign(local.y)};
+          depth = pen_y + radius;
+        }
+      }
+
+      // reflect velocity relative to the body
+      vec world = {Scalar::Mul(normal.x, axis.x) + Scalar::Mul(normal.y, perp.x),
+                   Scalar::Mul(normal.x, axis.y) + Scalar::Mul(normal.y, perp.y)};
+      vec velocity = Scalar::FromFixed(item.velocity);
+      Reflect({m_velocity.x - velocity.x, m_velocity.y - velocity.y}, world);
+      m_position.x += Scalar::Mul(depth, world.x);
+      m_position.y += Scalar::Mul(depth, world.y);
+      hit = index;
+      return true;
+    });
+
+    if (hit < 0) return 0;
+    if (!Block::BreakableOf(bodies.Get(hit).id)) return 0;
+    bodies.Remove(hit);
+    return 1;
   }
 
   /**
    * Draw ball to window
+   * Balls share one shape so that ball state stays trivially copyable
    * @param window window to draw on
+   * @param shape shape that represents balls
    */
-  void Draw(sf::RenderWindow &window) {
-    m_shape.setPosition(m_position);
-    window.draw(m_shape);
+  void Draw(sf::RenderWindow &window, sf::CircleShape &shape) const {
+    shape.setPosition(GetPosition());
+    window.draw(shape);
   }
 
   /**
@@ -254,7 +396,7 @@ public:
    * @return true if out of bounds
    */
   bool OutOfBounds() const {
-    return (m_position.y >= WINDOW_HEIGHT);
+    return (m_position.y >= Int(WINDOW_HEIGHT));
   }
 
   /**
@@ -262,14 +404,10 @@ public:
    * @return position
    */
   sf::Vector2f GetPosition() const {
-    return m_position;
+    return Scalar::ToVector(m_position);
   }
+};
 
-  /**
-   * Get angle that ball is travelling
-   * @return angle
-   */
-  double GetAngle() const {
-    return m_angle;
-  }
-};
\ No newline at end of file
+typedef BasicBall<float_scalar> Ball;
+
+static_assert(std::is_trivially_copyable_v<Ball>, "Ball state is saved to snapshots with memcpy");
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "SFML/Graphics.hpp"
+
+#include "constants.h"
+#include "game.h"
+
+/**
+ * Build a closed box level covering the whole window
+ * Walls on every side keep the balls bouncing for the whole run.
+ * @param spacing distance between unbreakable pillars, 0 for an empty box
+ * @param width width reference
+ * @param height height reference
+ * @return tile IDs
+ */
+std::vector<uint8_t> BoxLevel(int spacing, int &width, int &height) {
+  width = WINDOW_WIDTH / BLOCK_SIZE_TOTAL;
+  height = WINDOW_HEIGHT / BLOCK_SIZE_TOTAL;
+  std::vector<uint8_t> tiles(width * height, 0);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      bool wall = (x == 0 || y == 0 || x == width - 1 || y == height - 1);
+      // pillars stay clear of the rows the balls start in
+      bool pillar = spacing > 0 && x % spacing == spacing / 2 && y % spacing == spacing / 2 && y < height - 8;
+      if (wall || pillar) tiles[y * width + x] = 8;
+    }
+  }
+  return tiles;
+}
+
+/**
+ * Run one workload and print its throughput
+ * @param name workload name
+ * @param spacing pillar spacing, see BoxLevel
+ * @param splits number of times to split the balls
+ * @param ticks ticks to simulate
+ */
+void Run(const std::string &name, int spacing, int splits, uint64_t ticks) {
+  int width, height;
+  std::vector<uint8_t> tiles = BoxLevel(spacing, width, height);
+  Game game(width, height, tiles.data());
+
+  // let the ball leave the paddle before splitting
+  for (int i = 0; i < 10; i++) {
+    game.Step(WINDOW_HALF_WIDTH);
+  }
+  for (int i = 0; i < splits; i++) {
+    game.MultiplyBalls();
+    game.Step(WINDOW_HALF_WIDTH);
+  }
+
+  uint64_t ball_ticks = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t t = 0; t < ticks; t++) {
+    ball_ticks += game.GetBalls().size();
+    game.Step(WINDOW_HALF_WIDTH);
+  }
+  auto finished = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(finished - start).count();
+  std::cout << name << ": " << game.GetBalls().size() << " balls, " << ticks << " ticks, "
+            << ns / ball_ticks << " ns per ball tick" << std::endl;
+}
+
+/**
+ * Main function
+ * Bounce heavy workloads for comparing ball physics changes
+ * Compare Release builds; the ball loops only vectorize at -O3
+ * Arguments: ticks per workload
+ * @return success
+ */
+int main(int argc, char **argv) {
+  uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 20 * FRAME_RATE;
+
+  Run("empty box", 0, 6, ticks);
+  Run("pillars", 4, 6, ticks);
+  Run("dense pillars", 2, 6, ticks);
+
+  return 0;
+}
@@ -29,6 +29,15 @@ public:
     m_shape.setFillColor(GetColor());
   }
 
+  /**
+   * Change block ID in place
+   * @param id ID
+   */
+  void SetID(uint8_t id) {
+    m_id = id;
+    m_shape.setFillColor(GetColor());
+  }
+
   /**
    * Draw block to window
    * @param window window to draw on
@@ -58,12 +67,29 @@ public:
    * @return color
    */
   sf::Color GetColor() const {
-    uint8_t r = ((m_id >> 2) & 1) * 255;
-    uint8_t g = ((m_id >> 1) & 1) * 255;
-    uint8_t b = ((m_id) & 1) * 255;
+    return ColorOf(m_id);
+  }
+
+  /**
+   * Return true if block can be broken
+   * @return if block is breakable
+   */
+  bool GetBreakable() const {
+    return BreakableOf(m_id);
+  }
+
+  /**
+   * Get color for a block ID
+   * @param id ID
+   * @return color
+   */
+  static sf::Color ColorOf(uint8_t id) {
+    uint8_t r = ((id >> 2) & 1) * 255;
+    uint8_t g = ((id >> 1) & 1) * 255;
+    uint8_t b = ((id) & 1) * 255;
 
     sf::Color color;
-    if ((m_id >> 3) & 1) {
+    if ((id >> 3) & 1) {
       color = {127, 127, 127};
     } else {
       color = {r, g, b};
@@ -72,10 +98,11 @@ public:
   }
 
   /**
-   * Return true if block can be broken
+   * Return true if blocks with an ID can be broken
+   * @param id ID
    * @return if block is breakable
    */
-  bool GetBreakable() const {
-    return m_id != 8;
+  static bool BreakableOf(uint8_t id) {
+    return id != 8;
   }
 };
\ No newline at end of file
@@ -0,0 +1,291 @@
+#pragma once
+
+#include "SFML/Graphics.hpp"
+#include "block.h"
+#include "constants.h"
+#include "fixed.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+enum class body_kind : uint8_t {SLIDER, ROTATOR, DEBRIS};
+
+/// pull on debris per tick, 0.1 px
+const fixed DEBRIS_GRAVITY = FIXED_ONE / 10;
+
+/**
+ * Block that is not tied to a grid cell
+ * State is Q16.16 in every build, so moving blocks are bit-exact next to
+ * fixed point balls. Kept trivially copyable so bodies can be saved in
+ * snapshots.
+ */
+struct body {
+  body_kind kind = body_kind::SLIDER;
+  uint8_t id = 0;                 /// tile ID, sets colour and breakability
+  uint16_t padding = 0;           /// keeps snapshots free of indeterminate bytes
+  fixed_vec position;             /// center
+  fixed_vec velocity;             /// movement per tick (sliders, debris)
+  fixed_vec half;                 /// half extents along axis and its normal
+  fixed_vec axis{FIXED_ONE, 0};   /// local x axis, UnitAt(angle)
+  int32_t angle = 0;              /// rotation in angle steps
+  int32_t spin = 0;               /// rotation per tick in angle steps
+  fixed path_min = 0;             /// slider path start, x
+  fixed path_max = 0;             /// slider path end, x
+  int32_t cell = -1;              /// loose grid cell holding the body
+  uint32_t slot = 0;              /// position in that cell's list
+};
+
+static_assert(std::is_trivially_copyable_v<body>, "bodies are saved to snapshots with memcpy");
+
+/**
+ * Bodies class
+ * Moving blocks tracked in a loose grid. Each body lives in the cell that
+ * holds its center and queries widen by the largest body reach, so moving
+ * a body only touches the index when it crosses into another cell.
+ */
+class Bodies {
+private:
+  std::pmr::vector<body> m_bodies;                        /// body storage
+  std::pmr::vector<std::pmr::vector<uint32_t>> m_cells;   /// body indices per cell, empty until needed
+  int m_columns;                                          /// cells across
+  int m_rows;                                             /// cells down
+  fixed m_reach = 0;                                      /// largest body bounding radius
+  sf::VertexArray m_batch;                                /// two triangles per body
+
+  /**
+   * Get cell holding a position, clamped to the grid
+   * @param pos position
+   * @return cell index
+   */
+  int32_t CellOf(fixed_vec pos) const {
+    int x = std::clamp(FloorDiv(pos.x, ToFixed(BODY_CELL_SIZE)), 0, m_columns - 1);
+    int y = std::clamp(FloorDiv(pos.y, ToFixed(BODY_CELL_SIZE)), 0, m_rows - 1);
+    return x + y * m_columns;
+  }
+
+  /**
+   * Get bounding radius of a body, rounded up
+   * @param item body
+   * @return radius
+   */
+  static fixed ReachOf(const body &item) {
+    int64_t half_sq = static_cast<int64_t>(item.half.x) * item.half.x + static_cast<int64_t>(item.half.y) * item.half.y;
+    return static_cast<fixed>(ISqrt(half_sq)) + 1;
+  }
+
+  /**
+   * Add body to cell list
+   * @param index body index
+   * @param cell cell index
+   */
+  void Link(uint32_t index, int32_t cell) {
+    if (m_cells.empty()) m_cells.resize(m_columns * m_rows);
+    body &item = m_bodies[index];
+    item.cell = cell;
+    item.slot = m_cells[cell].size();
+    m_cells[cell].push_back(index);
+  }
+
+  /**
+   * Remove body from its cell list
+   * @param index body index
+   */
+  void Unlink(uint32_t index) {
+    body &item = m_bodies[index];
+    std::pmr::vector<uint32_t> &list = m_cells[item.cell];
+    uint32_t moved = list.back();
+    list[item.slot] = moved;
+    m_bodies[moved].slot = item.slot;
+    list.pop_back();
+    item.cell = -1;
+  }
+
+  /**
+   * Advance one body by a tick
+   * @param item body
+   * @return false if the body left the screen and should be removed
+   */
+  static bool Advance(body &item) {
+    switch (item.kind) {
+      case body_kind::SLIDER:
+        item.position.x += item.velocity.x;
+        item.position.y += item.velocity.y;
+        if ((item.position.x <= item.path_min && item.velocity.x < 0) ||
+            (item.position.x >= item.path_max && item.velocity.x > 0)) {
+          item.velocity.x = -item.velocity.x;
+        }
+        break;
+      case body_kind::ROTATOR:
+        // the axis comes from the table, so it never drifts off unit length
+        item.angle = ((item.angle + item.spin) % ANGLE_STEPS + ANGLE_STEPS) % ANGLE_STEPS;
+        item.axis = UnitAt(item.angle);
+        break;
+      case body_kind::DEBRIS:
+        item.velocity.y += DEBRIS_GRAVITY;
+        item.position.x += item.velocity.x;
+        item.position.y += item.velocity.y;
+        if (item.position.y - item.half.y > ToFixed(WINDOW_HEIGHT)) return false;
+        break;
+    }
+    return true;
+  }
+
+public:
+  /**
+   * Default constructor
+   * @param resource allocator for bodies and the index
+   */
+  explicit Bodies(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : m_bodies(resource), m_cells(resource) {
+    m_columns = (WINDOW_WIDTH + BODY_CELL_SIZE - 1) / BODY_CELL_SIZE;
+    m_rows = (WINDOW_HEIGHT + BODY_CELL_SIZE - 1) / BODY_CELL_SIZE;
+    m_batch.setPrimitiveType(sf::PrimitiveType::Triangles);
+  }
+
+  /**
+   * Add a body
+   * @param item body to add
+   */
+  void Add(body item) {
+    m_reach = std::max(m_reach, ReachOf(item));
+    m_bodies.push_back(item);
+    Link(m_bodies.size() - 1, CellOf(item.position));
+  }
+
+  /**
+   * Remove a body, moving the last body into its place
+   * @param index body index
+   */
+  void Remove(uint32_t index) {
+    Unlink(index);
+    uint32_t last = m_bodies.size() - 1;
+    if (index != last) {
+      m_bodies[index] = m_bodies[last];
+      m_cells[m_bodies[index].cell][m_bodies[index].slot] = index;
+    }
+    m_bodies.pop_back();
+  }
+
+  /**
+   * Replace all bodies, rebuilding the index
+   * @param items bodies
+   * @param count number of bodies
+   */
+  void Assign(const body *items, size_t count) {
+    for (std::pmr::vector<uint32_t> &list : m_cells) list.clear();
+    m_bodies.assign(items, items + count);
+    m_reach = 0;
+    for (uint32_t i = 0; i < m_bodies.size(); i++) {
+      const body &item = m_bodies[i];
+      m_reach = std::max(m_reach, ReachOf(item));
+      Link(i, CellOf(item.position));
+    }
+  }
+
+  /**
+   * Remove every body and free all storage
+   */
+  void Clear() {
+    m_bodies = std::pmr::vector<body>(m_bodies.get_allocator());
+    m_cells = std::pmr::vector<std::pmr::vector<uint32_t>>(m_cells.get_allocator());
+    m_reach = 0;
+    m_batch.clear();
+  }
+
+  /**
+   * Move every body by one tick, relinking only bodies that changed cell
+   */
+  void Update() {
+    TRACE_ZONE("Bodies::Update");
+    for (uint32_t i = 0; i < m_bodies.size();) {
+      if (!Advance(m_bodies[i])) {
+        Remove(i);
+        continue;
+      }
+
+      int32_t cell = CellOf(m_bodies[i].position);
+      if (cell != m_bodies[i].cell) {
+        Unlink(i);
+        Link(i, cell);
+      }
+      i++;
+    }
+  }
+
+  /**
+   * Visit bodies that may overlap a circle
+   * Only cells within the circle plus the largest body reach are visited.
+   * @param pos circle center
+   * @param radius circle radius
+   * @param visit called with each body index, return true to stop
+   * @return number of bodies visited
+   */
+  template <typename F>
+  uint32_t Query(fixed_vec pos, fixed radius, F &&visit) const {
+    if (m_bodies.empty()) return 0;
+    const fixed size = ToFixed(BODY_CELL_SIZE);
+    fixed reach = radius + m_reach;
+    int x0 = std::max(FloorDiv(pos.x - reach, size), 0);
+    int y0 = std::max(FloorDiv(pos.y - reach, size), 0);
+    int x1 = std::min(FloorDiv(pos.x + reach, size), m_columns - 1);
+    int y1 = std::min(FloorDiv(pos.y + reach, size), m_rows - 1);
+
+    uint32_t visited = 0;
+    for (int y = y0; y <= y1; y++) {
+      for (int x = x0; x <= x1; x++) {
+        for (uint32_t index : m_cells[x + y * m_columns]) {
+          visited++;
+          if (visit(index)) return visited;
+        }
+      }
+    }
+    return visited;
+  }
+
+  /**
+   * Get body
+   * @param index body index
+   * @return body
+   */
+  const body &Get(uint32_t index) const {
+    return m_bodies[index];
+  }
+
+  /**
+   * Get all bodies
+   * @return bodies
+   */
+  const std::pmr::vector<body> &GetAll() const {
+    return m_bodies;
+  }
+
+  /**
+   * Draw bodies to window
+   * @param window window to draw on
+   */
+  void Draw(sf::RenderWindow &window) {
+    m_batch.resize(m_bodies.size() * 6);
+    for (uint32_t i = 0; i < m_bodies.size(); i++) {
+      const body &item = m_bodies[i];
+      sf::Vector2f position = ToFloat(item.position);
+      sf::Vector2f axis = ToFloat(item.axis);
+      sf::Vector2f x_extent = ToFloat(item.half.x) * axis;
+      sf::Vector2f y_extent = ToFloat(item.half.y) * sf::Vector2f(-axis.y, axis.x);
+      sf::Vector2f corners[4] = {position - x_extent - y_extent,
+                                 position + x_extent - y_extent,
+                                 position - x_extent + y_extent,
+                                 position + x_extent + y_extent};
+      sf::Color color = Block::ColorOf(item.id);
+      const int order[6] = {0, 1, 2, 2, 1, 3};
+      for (int v = 0; v < 6; v++) {
+        m_batch[i * 6 + v].position = corners[order[v]];
+        m_batch[i * 6 + v].color = color;
+      }
+    }
+    window.draw(m_batch);
+  }
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "SFML/Graphics.hpp"
+#include "constants.h"
+#include "fixed.h"
+
+/// Bits of the 3x3 neighbourhood mask, row major around the ball's cell
+const uint16_t TILE_NW = 1 << 0;
+const uint16_t TILE_N = 1 << 1;
+const uint16_t TILE_NE = 1 << 2;
+const uint16_t TILE_W = 1 << 3;
+const uint16_t TILE_CENTER = 1 << 4;
+const uint16_t TILE_E = 1 << 5;
+const uint16_t TILE_SW = 1 << 6;
+const uint16_t TILE_S = 1 << 7;
+const uint16_t TILE_SE = 1 << 8;
+const uint32_t TILE_MASKS = 1 << 9;
+
+/**
+ * Collision response for a set of touched tiles
+ * nx/ny give the sign of the surface normal on each axis (the direction the
+ * ball must travel afterwards); corner means the ball touches an exposed
+ * block corner, which sits in the cell corner the normal points away from,
+ * so it reflects off the normal from that corner to the ball instead of
+ * flipping the axes independently
+ */
+struct tile_response {
+  int8_t nx = 0;
+  int8_t ny = 0;
+  bool corner = false;
+};
+
+/**
+ * Build response for every combination of touched tiles
+ * A diagonal tile can only be touched if both faces next to it are touched
+ * too, so a diagonal hit alongside an occupied face is a seam or an inside
+ * corner and is covered by the face response.
+ * @return table indexed by touched tile mask
+ */
+constexpr std::array<tile_response, TILE_MASKS> BuildTileResponses() {
+  std::array<tile_response, TILE_MASKS> table{};
+
+  for (uint32_t hit = 0; hit < TILE_MASKS; hit++) {
+    int nx = 0;
+    int ny = 0;
+    bool corner = false;
+
+    if (hit & (TILE_N | TILE_S | TILE_W | TILE_E)) {
+      if (hit & TILE_N) ny++;
+      if (hit & TILE_S) ny--;
+      if (hit & TILE_W) nx++;
+      if (hit & TILE_E) nx--;
+    } else {
+      // exposed corners only, combine their diagonals
+      if (hit & TILE_NW) { nx++; ny++; }
+      if (hit & TILE_NE) { nx--; ny++; }
+      if (hit & TILE_SW) { nx++; ny--; }
+      if (hit & TILE_SE) { nx--; ny--; }
+      nx = (nx > 0) - (nx < 0);
+      ny = (ny > 0) - (ny < 0);
+      corner = (nx != 0 && ny != 0);
+    }
+
+    table[hit].nx = static_cast<int8_t>(nx);
+    table[hit].ny = static_cast<int8_t>(ny);
+    table[hit].corner = corner;
+  }
+
+  return table;
+}
+
+constexpr std::array<tile_response, TILE_MASKS> TILE_RESPONSES = BuildTileResponses();
+
+/**
+ * Face neighbour a ball can be pushed into when its centre is inside a block
+ */
+struct tile_exit {
+  uint16_t tile;  /// neighbour tile bit
+  int8_t dx;      /// x direction of the push
+  int8_t dy;      /// y direction of the push
+};
+
+constexpr std::array<tile_exit, 4> TILE_EXITS = {{{TILE_W, -1, 0}, {TILE_E, 1, 0}, {TILE_N, 0, -1}, {TILE_S, 0, 1}}};
+
+/**
+ * Get which tiles of the 3x3 neighbourhood a ball overlaps
+ * @param ox ball x offset inside its cell, [0, BLOCK_SIZE_TOTAL)
+ * @param oy ball y offset inside its cell, [0, BLOCK_SIZE_TOTAL)
+ * @return mask of touched tiles
+ */
+inline uint16_t TouchMask(float ox, float oy) {
+  const float far = BLOCK_SIZE_TOTAL - BALL_RADIUS;
+  const float radius_sq = BALL_RADIUS * BALL_RADIUS;
+  float ix = BLOCK_SIZE_TOTAL - ox;
+  float iy = BLOCK_SIZE_TOTAL - oy;
+
+  uint16_t mask = TILE_CENTER;
+  mask |= (oy <= BALL_RADIUS) * TILE_N;
+  mask |= (oy >= far) * TILE_S;
+  mask |= (ox <= BALL_RADIUS) * TILE_W;
+  mask |= (ox >= far) * TILE_E;
+  mask |= (ox * ox + oy * oy <= radius_sq) * TILE_NW;
+  mask |= (ix * ix + oy * oy <= radius_sq) * TILE_NE;
+  mask |= (ox * ox + iy * iy <= radius_sq) * TILE_SW;
+  mask |= (ix * ix + iy * iy <= radius_sq) * TILE_SE;
+  return mask;
+}
+
+/**
+ * Get which tiles of the 3x3 neighbourhood a ball overlaps, in fixed point
+ * @param ox ball x offset inside its cell, [0, BLOCK_SIZE_TOTAL)
+ * @param oy ball y offset inside its cell, [0, BLOCK_SIZE_TOTAL)
+ * @return mask of touched tiles
+ */
+inline uint16_t TouchMask(fixed ox, fixed oy) {
+  const fixed radius = ToFixed(BALL_RADIUS);
+  const fixed far = ToFixed(BLOCK_SIZE_TOTAL - BALL_RADIUS);
+  const int64_t radius_sq = static_cast<int64_t>(radius) * radius;
+  int64_t x = ox, y = oy;
+  int64_t ix = ToFixed(BLOCK_SIZE_TOTAL) - x;
+  int64_t iy = ToFixed(BLOCK_SIZE_TOTAL) - y;
+
+  uint16_t mask = TILE_CENTER;
+  mask |= (oy <= radius) * TILE_N;
+  mask |= (oy >= far) * TILE_S;
+  mask |= (ox <= radius) * TILE_W;
+  mask |= (ox >= far) * TILE_E;
+  mask |= (x * x + y * y <= radius_sq) * TILE_NW;
+  mask |= (ix * ix + y * y <= radius_sq) * TILE_NE;
+  mask |= (x * x + iy * iy <= radius_sq) * TILE_SW;
+  mask |= (ix * ix + iy * iy <= radius_sq) * TILE_SE;
+  return mask;
+}
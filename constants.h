@@ -22,8 +22,11 @@ const int BLOCK_HALF_SIZE = BLOCK_SIZE / 2;
 const int GRID_WIDTH = WINDOW_WIDTH / BLOCK_SIZE_TOTAL;
 const int GRID_HEIGHT = 32;
 
+const int BODY_CELL_SIZE = 4 * BLOCK_SIZE_TOTAL;
+
 const sf::Color BACKGROUND_COLOR = sf::Color::Black;
 const sf::Color PLAYER_COLOR = sf::Color::White;
 const sf::Color BALL_COLOR = sf::Color::White;
 
-enum class collision_type {NONE, VERTICAL, HORIZONTAL, CORNER};
\ No newline at end of file
+const uint64_t GAME_SEED = 0x9E3779B97F4A7C15ULL;
+const int REWIND_SECONDS = 5;
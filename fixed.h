@@ -0,0 +1,246 @@
+#pragma once
+
+#include "SFML/Graphics.hpp"
+#include "constants.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+/**
+ * Q16.16 fixed point for the deterministic ball physics mode and for moving
+ * blocks in every mode
+ * Everything here is integer arithmetic, including the constexpr tables, so
+ * results do not depend on compiler, flags or platform.
+ */
+
+typedef int32_t fixed;
+
+const int FIXED_SHIFT = 16;
+const fixed FIXED_ONE = 1 << FIXED_SHIFT;
+
+/**
+ * Fixed point vector
+ */
+struct fixed_vec {
+  fixed x = 0;
+  fixed y = 0;
+};
+
+/**
+ * Convert whole number to fixed point
+ * @param value value
+ * @return fixed point value
+ */
+constexpr fixed ToFixed(int value) {
+  return value * FIXED_ONE;
+}
+
+/**
+ * Convert float to fixed point, truncating
+ * Scaling by a power of two is exact, so the result only depends on the input
+ * @param value value
+ * @return fixed point value
+ */
+inline fixed ToFixed(float value) {
+  return static_cast<fixed>(value * FIXED_ONE);
+}
+
+/**
+ * Convert fixed point to float
+ * @param value fixed point value
+ * @return value
+ */
+constexpr float ToFloat(fixed value) {
+  return static_cast<float>(value) / FIXED_ONE;
+}
+
+/**
+ * Convert fixed point vector to float
+ * @param value fixed point vector
+ * @return vector
+ */
+inline sf::Vector2f ToFloat(fixed_vec value) {
+  return {ToFloat(value.x), ToFloat(value.y)};
+}
+
+/**
+ * Multiply fixed point values
+ * @param a fixed point value
+ * @param b fixed point value
+ * @return product
+ */
+constexpr fixed FixedMul(fixed a, fixed b) {
+  return static_cast<fixed>((static_cast<int64_t>(a) * b) >> FIXED_SHIFT);
+}
+
+/**
+ * Divide fixed point values
+ * @param a fixed point value
+ * @param b fixed point value, not zero
+ * @return quotient
+ */
+constexpr fixed FixedDiv(fixed a, fixed b) {
+  return static_cast<fixed>((static_cast<int64_t>(a) << FIXED_SHIFT) / b);
+}
+
+/**
+ * Integer square root, rounded down
+ * @param value value, not negative
+ * @return square root
+ */
+constexpr uint32_t ISqrt(uint64_t value) {
+  uint64_t result = 0;
+  uint64_t bit = uint64_t(1) << 62;
+  while (bit > value) bit >>= 2;
+  while (bit != 0) {
+    if (value >= result + bit) {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return static_cast<uint32_t>(result);
+}
+
+/**
+ * Get unit vector along a direction
+ * Short vectors are scaled up before the square root, so a direction only a
+ * few units long still gives a normal of unit length.
+ * @param x x component
+ * @param y y component, not zero if x is zero
+ * @return unit vector
+ */
+constexpr fixed_vec FixedNormalize(fixed x, fixed y) {
+  uint64_t largest = std::max(x < 0 ? -int64_t(x) : int64_t(x), y < 0 ? -int64_t(y) : int64_t(y));
+  int shift = 30 - std::bit_width(largest);
+  int64_t sx = (shift >= 0) ? int64_t(x) * (int64_t(1) << shift) : int64_t(x) >> -shift;
+  int64_t sy = (shift >= 0) ? int64_t(y) * (int64_t(1) << shift) : int64_t(y) >> -shift;
+  int64_t length = ISqrt(static_cast<uint64_t>(sx * sx + sy * sy));
+  return {static_cast<fixed>(sx * FIXED_ONE / length), static_cast<fixed>(sy * FIXED_ONE / length)};
+}
+
+/**
+ * Divide rounding towards negative infinity
+ * @param a dividend
+ * @param b divisor, positive
+ * @return quotient
+ */
+constexpr int32_t FloorDiv(int32_t a, int32_t b) {
+  return a / b - (a % b < 0);
+}
+
+/// pi in Q2.30
+constexpr int64_t PI_Q30 = 3373259426;
+
+/**
+ * Sine by Taylor series in Q2.30
+ * @param x angle in radians, Q2.30, within [-pi/2, pi/2]
+ * @return sine, Q2.30
+ */
+constexpr int64_t SinQ30(int64_t x) {
+  int64_t x2 = (x * x) >> 30;
+  int64_t term = x;
+  int64_t sum = x;
+  for (int k = 1; k < 8; k++) {
+    term = -((term * x2) >> 30) / ((2 * k) * (2 * k + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+/**
+ * Cosine by Taylor series in Q2.30
+ * @param x angle in radians, Q2.30, within [-pi/2, pi/2]
+ * @return cosine, Q2.30
+ */
+constexpr int64_t CosQ30(int64_t x) {
+  int64_t x2 = (x * x) >> 30;
+  int64_t term = int64_t(1) << 30;
+  int64_t sum = term;
+  for (int k = 1; k < 8; k++) {
+    term = -((term * x2) >> 30) / ((2 * k - 1) * (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+/**
+ * Scale a Q2.30 value to fixed point, rounding to nearest
+ * @param value Q2.30 value
+ * @param scale fixed point scale
+ * @return fixed point value
+ */
+constexpr fixed ScaleQ30(int64_t value, fixed scale) {
+  return static_cast<fixed>((value * scale + (int64_t(1) << 29)) >> 30);
+}
+
+/// paddle table entries per pixel of hit offset
+const int PADDLE_SUBSTEPS = 4;
+const int PADDLE_STEPS = PLAYER_WIDTH * PADDLE_SUBSTEPS + 1;
+
+/**
+ * Build ball velocities for each hit offset along the paddle
+ * Same mapping as the float ball: offset maps linearly to [-pi/2, pi/2]
+ * from straight up, clamped to 4/10 pi either side.
+ * @return velocity per offset step, left edge first
+ */
+constexpr std::array<fixed_vec, PADDLE_STEPS> BuildPaddleVelocities() {
+  std::array<fixed_vec, PADDLE_STEPS> table{};
+  const int64_t limit = 4 * PADDLE_STEPS / 10;
+  for (int i = 0; i < PADDLE_STEPS; i++) {
+    int64_t step = i - PADDLE_STEPS / 2;
+    if (step > limit) step = limit;
+    if (step < -limit) step = -limit;
+    int64_t angle = PI_Q30 * step / (PADDLE_STEPS - 1);
+    table[i] = {ScaleQ30(SinQ30(angle), ToFixed(BALL_SPEED)), -ScaleQ30(CosQ30(angle), ToFixed(BALL_SPEED))};
+  }
+  return table;
+}
+
+constexpr std::array<fixed_vec, PADDLE_STEPS> PADDLE_VELOCITIES = BuildPaddleVelocities();
+
+/// 1 / sqrt(2), corner normal when the ball centre sits exactly on the corner
+constexpr fixed CORNER_DIAGONAL = ScaleQ30(SinQ30(PI_Q30 / 4), FIXED_ONE);
+
+/// rotation by a third of a turn as (cos, sin), cos(2pi/3) = -sin(pi/6) and sin(2pi/3) = cos(pi/6)
+constexpr fixed_vec THIRD_TURN = {-ScaleQ30(SinQ30(PI_Q30 / 6), FIXED_ONE), ScaleQ30(CosQ30(PI_Q30 / 6), FIXED_ONE)};
+
+/// rotation steps per degree for moving blocks, and per full and quarter turn
+const int ANGLE_STEPS_PER_DEGREE = 16;
+const int ANGLE_STEPS = 360 * ANGLE_STEPS_PER_DEGREE;
+const int QUARTER_STEPS = ANGLE_STEPS / 4;
+
+/**
+ * Build sines over a quarter turn
+ * @return sine per angle step, both ends included
+ */
+constexpr std::array<fixed, QUARTER_STEPS + 1> BuildQuarterSines() {
+  std::array<fixed, QUARTER_STEPS + 1> table{};
+  for (int i = 0; i <= QUARTER_STEPS; i++) {
+    table[i] = ScaleQ30(SinQ30(PI_Q30 * i / (2 * QUARTER_STEPS)), FIXED_ONE);
+  }
+  return table;
+}
+
+constexpr std::array<fixed, QUARTER_STEPS + 1> QUARTER_SINES = BuildQuarterSines();
+
+/**
+ * Get unit vector at an angle, folding the quarter turn table
+ * @param angle angle in steps, [0, ANGLE_STEPS)
+ * @return (cos, sin)
+ */
+constexpr fixed_vec UnitAt(int32_t angle) {
+  int32_t step = angle % QUARTER_STEPS;
+  fixed s = QUARTER_SINES[step];
+  fixed c = QUARTER_SINES[QUARTER_STEPS - step];
+  switch (angle / QUARTER_STEPS) {
+    case 0: return {c, s};
+    case 1: return {-s, c};
+    case 2: return {-c, -s};
+    default: return {s, -c};
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "SFML/Graphics.hpp"
+#include "ball.h"
+#include "fixed.h"
+
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Scalar operations for fixed point balls, see float_scalar
+ * Every operation is integer arithmetic and every bounce comes from integer
+ * tables, so a run is bit-exact across builds, platforms and thread counts.
+ */
+struct fixed_scalar {
+  typedef fixed value;          /// coordinate type, Q16.16
+  typedef fixed_vec vec;        /// vector type
+  typedef int64_t wide;         /// type of squared lengths, Q32.32
+
+  static constexpr value CORNER_DIAGONAL = ::CORNER_DIAGONAL;
+  static constexpr value THIRD_TURN_COS = THIRD_TURN.x;
+  static constexpr value THIRD_TURN_SIN = THIRD_TURN.y;
+
+  static value FromInt(int number) { return ::ToFixed(number); }
+  static value FromFloat(float number) { return ::ToFixed(number); }
+  static vec FromFixed(fixed_vec v) { return v; }
+  static fixed_vec ToFixed(vec v) { return v; }
+  static sf::Vector2f ToVector(vec v) { return ToFloat(v); }
+  static value Mul(value a, value b) { return FixedMul(a, b); }
+  static wide LengthSq(vec v) { return static_cast<int64_t>(v.x) * v.x + static_cast<int64_t>(v.y) * v.y; }
+  static value Length(wide length_sq) { return static_cast<fixed>(ISqrt(length_sq)); }
+  static vec Direction(vec v, value) { return FixedNormalize(v.x, v.y); }
+  static value Sign(value number) { return (number < 0) ? -FIXED_ONE : FIXED_ONE; }
+  static int Floor(value number) { return number >> FIXED_SHIFT; }
+  static int CellOf(value coordinate) { return FloorDiv(coordinate, ::ToFixed(BLOCK_SIZE_TOTAL)); }
+  static vec PaddleVelocity(int step) { return PADDLE_VELOCITIES[step]; }
+};
+
+/// Ball for the deterministic physics mode
+typedef BasicBall<fixed_scalar> FixedBall;
+
+static_assert(std::is_trivially_copyable_v<FixedBall>, "Ball state is saved to snapshots with memcpy");
@@ -0,0 +1,392 @@
+#pragma once
+
+#include "SFML/Graphics.hpp"
+#include "ball.h"
+#include "bodies.h"
+#include "constants.h"
+#include "fixed_ball.h"
+#include "grid.h"
+#include "memory.h"
+#include "metrics.h"
+#include "player.h"
+#include "script.h"
+#include "snapshot.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef BREAKOUT_FIXED_POINT
+typedef FixedBall game_ball;
+#else
+typedef Ball game_ball;
+#endif
+
+/**
+ * Game class
+ * Holds the whole simulation state and advances it one tick at a time,
+ * independent of any window so it can also run headless.
+ */
+class Game {
+private:
+  Memory m_memory;                      /// Arenas, first so they outlive every subsystem
+  Player m_player;                      /// Player paddle
+  Grid m_grid;                          /// Grid of blocks
+  Bodies m_bodies;                      /// Moving blocks
+  Scheduler m_scripts;                  /// Level scripts, rebuilt from m_script on Restore
+  std::pmr::vector<game_ball> m_balls;  /// Currently active balls
+  std::string m_script;                 /// Level script text, empty if the level has none
+  uint64_t m_tick = 0;                  /// Ticks simulated so far
+  uint64_t m_rng = GAME_SEED;           /// Random number generator state
+  sf::CircleShape m_ball_shape;         /// Shape shared by all balls when drawing
+
+  /**
+   * Get where the tile IDs start in a snapshot
+   * @param snapshot snapshot
+   * @return tile IDs
+   */
+  static const uint8_t *SnapshotTiles(const Snapshot &snapshot) {
+    snapshot_header header = snapshot.GetHeader();
+    size_t offset = sizeof(header) + header.ball_count * sizeof(game_ball) + header.body_count * sizeof(body);
+    return reinterpret_cast<const uint8_t *>(snapshot.Data() + offset);
+  }
+
+  /**
+   * Set up shared ball shape
+   */
+  void InitShape() {
+    m_ball_shape.setRadius(BALL_RADIUS);
+    m_ball_shape.setOrigin({BALL_RADIUS, BALL_RADIUS});
+    m_ball_shape.setFillColor(BALL_COLOR);
+  }
+
+public:
+  /**
+   * Default constructor
+   * @param filename name of level file
+   */
+  Game(const std::string &filename)
+      : m_grid(filename, m_memory.Get(subsystem::GRID)),
+        m_bodies(m_memory.Get(subsystem::BODIES)),
+        m_scripts(m_memory.Get(subsystem::SCRIPTS)),
+        m_balls(m_memory.Get(subsystem::BALLS)),
+        m_script(ReadScripts(ScriptFileFor(filename))) {
+    InitShape();
+    m_balls.emplace_back();
+    StartScripts(m_script, m_scripts, m_grid, m_bodies);
+  }
+
+  /**
+   * Headless constructor for generated levels, no level scripts
+   * @param width width of grid
+   * @param height height of grid
+   * @param tiles tile IDs, row major
+   */
+  Game(int width, int height, const uint8_t *tiles)
+      : m_grid(width, height, tiles, m_memory.Get(subsystem::GRID)),
+        m_bodies(m_memory.Get(subsystem::BODIES)),
+        m_scripts(m_memory.Get(subsystem::SCRIPTS)),
+        m_balls(m_memory.Get(subsystem::BALLS)) {
+    InitShape();
+    m_balls.emplace_back();
+  }
+
+  /**
+   * Fork constructor
+   * @param snapshot state to start from
+   * @param script level script text, see GetScript, so the fork runs the
+   *               events still due after the snapshot
+   */
+  Game(const Snapshot &snapshot, const std::string &script = "")
+      : m_grid(snapshot.GetHeader().grid_width, snapshot.GetHeader().grid_height, SnapshotTiles(snapshot),
+               m_memory.Get(subsystem::GRID)),
+        m_bodies(m_memory.Get(subsystem::BODIES)),
+        m_scripts(m_memory.Get(subsystem::SCRIPTS)),
+        m_balls(m_memory.Get(subsystem::BALLS)),
+        m_script(script) {
+    InitShape();
+    Restore(snapshot);
+  }
+
+  /**
+   * Advance simulation by one tick
+   * @param paddle_x player position
+   */
+  void Step(float paddle_x) {
+    TRACE_ZONE("Game::Step");
+    m_player.Move({paddle_x, PLAYER_Y});
+    m_scripts.Run(m_tick);
+    m_bodies.Update();
+
+    // balls never interact, so moving them all first changes nothing;
+    // zones cover all balls at once to keep the trace ring to a few per tick
+    {
+      TRACE_ZONE("Game::MoveBalls");
+      game_ball::MoveAll(m_balls);
+    }
+    uint32_t broken = 0;
+    uint32_t tests = 0;
+    {
+      TRACE_ZONE("Game::Collide");
+      for (game_ball &ball : m_balls) {
+        ball.PlayerCollision(m_player);
+        broken += ball.GridCollision(m_grid, tests);
+        broken += ball.BodyCollision(m_bodies, tests);
+      }
+    }
+    METRIC_ADD(collision_tests, tests);
+    METRIC_SET(collision_tests_last_tick, tests);
+    METRIC_ADD(blocks_broken, broken);
+
+    // delete balls if out of bounds
+    {
+      TRACE_ZONE("Game::EraseBalls");
+      std::erase_if(m_balls, [](const game_ball &ball) { return ball.OutOfBounds(); });
+    }
+    m_tick++;
+    METRIC_ADD(ticks, 1);
+    METRIC_SET(live_balls, m_balls.size());
+  }
+
+  /**
+   * Change level, dropping everything from the current one
+   * Every subsystem frees its storage before the arenas are reset, so the
+   * new level starts from empty pools
+   * @param filename name of level file
+   */
+  void Load(const std::string &filename) {
+    TRACE_ZONE("Game::Load");
+    m_scripts.Clear();
+    m_bodies.Clear();
+    m_balls = std::pmr::vector<game_ball>(m_memory.Get(subsystem::BALLS));
+    m_grid.Clear();
+    m_memory.Reset();
+
+    m_grid.Load(filename);
+    m_player.Move({WINDOW_HALF_WIDTH, PLAYER_Y});
+    m_tick = 0;
+    m_rng = GAME_SEED;
+    m_balls.emplace_back();
+    m_script = ReadScripts(ScriptFileFor(filename));
+    StartScripts(m_script, m_scripts, m_grid, m_bodies);
+  }
+
+  /**
+   * Reload level file, touching only tiles that changed
+   * @param filename name of level file
+   */
+  void Reload(const std::string &filename) {
+    m_grid.Reload(filename);
+  }
+
+  /**
+   * Multiply balls power up
+   */
+  void MultiplyBalls() {
+    TRACE_ZONE("Game::MultiplyBalls");
+    size_t count = m_balls.size();
+    m_balls.reserve(count * 3);
+    for (size_t i = 0; i < count; i++) {
+      m_balls.push_back(m_balls[i].Turned(false));
+      m_balls.push_back(m_balls[i].Turned(true));
+    }
+  }
+
+  /**
+   * Get next random number (xorshift64*)
+   * Part of the saved state so forks and rewinds stay deterministic
+   * @return random number
+   */
+  uint32_t Random() {
+    m_rng ^= m_rng >> 12;
+    m_rng ^= m_rng << 25;
+    m_rng ^= m_rng >> 27;
+    return static_cast<uint32_t>((m_rng * 0x2545F4914F6CDD1DULL) >> 32);
+  }
+
+  /**
+   * Save state into snapshot
+   * @param snapshot snapshot to overwrite
+   */
+  void Save(Snapshot &snapshot) const {
+    TRACE_ZONE("Game::Save");
+    snapshot_header header;
+    header.tick = m_tick;
+    header.rng = m_rng;
+    header.paddle_x = m_player.GetPosition().x;
+    header.ball_count = m_balls.size();
+    header.body_count = m_bodies.GetAll().size();
+    header.grid_width = m_grid.GetWidth();
+    header.grid_height = m_grid.GetHeight();
+
+    size_t balls_size = m_balls.size() * sizeof(game_ball);
+    size_t bodies_size = m_bodies.GetAll().size() * sizeof(body);
+    const std::pmr::vector<uint8_t> &tiles = m_grid.GetTiles();
+    std::byte *out = snapshot.Resize(sizeof(header) + balls_size + bodies_size + tiles.size());
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    if (balls_size > 0) std::memcpy(out, m_balls.data(), balls_size);
+    out += balls_size;
+    if (bodies_size > 0) std::memcpy(out, m_bodies.GetAll().data(), bodies_size);
+    out += bodies_size;
+    std::memcpy(out, tiles.data(), tiles.size());
+  }
+
+  /**
+   * Restore state from snapshot
+   * Only grid tiles that differ are touched. Scripts keep no state of their
+   * own, so they are started again from the restored tick.
+   * @param snapshot snapshot to restore
+   */
+  void Restore(const Snapshot &snapshot) {
+    TRACE_ZONE("Game::Restore");
+    snapshot_header header = snapshot.GetHeader();
+    m_tick = header.tick;
+    m_rng = header.rng;
+    m_player.Move({header.paddle_x, PLAYER_Y});
+
+    const std::byte *in = snapshot.Data() + sizeof(header);
+    m_balls.resize(header.ball_count);
+    if (header.ball_count > 0) std::memcpy(m_balls.data(), in, header.ball_count * sizeof(game_ball));
+    in += header.ball_count * sizeof(game_ball);
+    m_bodies.Assign(reinterpret_cast<const body *>(in), header.body_count);
+    in += header.body_count * sizeof(body);
+    m_grid.ApplyTiles(header.grid_width, header.grid_height, reinterpret_cast<const uint8_t *>(in));
+
+    m_scripts.Clear();
+    StartScripts(m_script, m_scripts, m_grid, m_bodies, m_tick);
+  }
+
+  /**
+   * Draw game to window
+   * @param window window to draw on
+   */
+  void Draw(sf::RenderWindow &window) {
+    TRACE_ZONE("Game::Draw");
+    m_player.Draw(window);
+    for (const game_ball &ball : m_balls) {
+      ball.Draw(window, m_ball_shape);
+    }
+    m_grid.Draw(window);
+    m_bodies.Draw(window);
+  }
+
+  /**
+   * Check if all balls are gone
+   * @return true if game is lost
+   */
+  bool Lost() const {
+    return m_balls.empty();
+  }
+
+  /**
+   * Check if all breakable blocks are gone
+   * @return true if game is won
+   */
+  bool Won() const {
+    return m_grid.Finished();
+  }
+
+  /**
+   * Get active balls
+   * @return balls
+   */
+  const std::pmr::vector<game_ball> &GetBalls() const {
+    return m_balls;
+  }
+
+  /**
+   * Get grid of blocks
+   * @return grid
+   */
+  const Grid &GetGrid() const {
+    return m_grid;
+  }
+
+  /**
+   * Get moving blocks
+   * @return bodies
+   */
+  const Bodies &GetBodies() const {
+    return m_bodies;
+  }
+
+  /**
+   * Get memory arenas
+   * @return memory
+   */
+  const Memory &GetMemory() const {
+    return m_memory;
+  }
+
+  /**
+   * Get player
+   * @return player
+   */
+  const Player &GetPlayer() const {
+    return m_player;
+  }
+
+  /**
+   * Get ticks simulated so far
+   * @return tick
+   */
+  uint64_t GetTick() const {
+    return m_tick;
+  }
+
+  /**
+   * Get level script text
+   * @return script text, empty if the level has none
+   */
+  const std::string &GetScript() const {
+    return m_script;
+  }
+};
+
+/// Paddle policy for forked games, returns player position for the tick
+typedef std::function<float(const Game &)> paddle_policy;
+
+/**
+ * Fork a state and simulate alternatives in parallel
+ * Each fork runs until it is won, lost, or has run for the given ticks.
+ * @param origin state to fork from
+ * @param policies one paddle policy per fork
+ * @param ticks maximum ticks to simulate
+ * @param script level script text of the origin game, see Game::GetScript
+ * @return final state of each fork
+ */
+inline std::vector<Snapshot> ForkAndRun(const Snapshot &origin,
+                                        const std::vector<paddle_policy> &policies,
+                                        uint64_t ticks,
+                                        const std::string &script = "")
+{
+  std::vector<Snapshot> results(policies.size());
+  size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), policies.size());
+  std::vector<std::thread> threads;
+
+  for (size_t w = 0; w < workers; w++) {
+    threads.emplace_back([&, w]() {
+      TRACE_THREAD("fork worker " + std::to_string(w));
+      for (size_t i = w; i < policies.size(); i += workers) {
+        TRACE_ZONE("Fork");
+        Game game(origin, script);
+        for (uint64_t t = 0; t < ticks && !game.Lost() && !game.Won(); t++) {
+          game.Step(policies[i](game));
+        }
+        game.Save(results[i]);
+      }
+    });
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  return results;
+}
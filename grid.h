@@ -3,46 +3,142 @@
 #include "SFML/Graphics.hpp"
 #include "block.h"
 #include "constants.h"
+#include "level.h"
+#include "metrics.h"
+#include "trace.h"
 
-typedef std::map<uint32_t, std::shared_ptr<Block>> block_map;
+#include <bit>
+#include <memory_resource>
+#include <vector>
 
 /**
  * Grid class
+ * Tiles are plain IDs plus bitboards, there is no object per block
  */
 class Grid {
 private:
   sf::Vector2f m_origin;      /// Origin of the grid
-  block_map m_blocks;
-  int m_width;
-  int m_height;
-  uint32_t m_breakable_blocks = 0;
+  int m_width = 0;
+  int m_height = 0;
+  std::pmr::vector<uint8_t> m_tiles;      /// tile ID per cell, 0 if empty
+  int m_row_words = 0;                    /// 64-bit words per bitboard row
+  std::pmr::vector<uint64_t> m_occupied;  /// one bit per tile with a block
+  std::pmr::vector<uint64_t> m_breakable; /// one bit per tile with a breakable block
+  sf::VertexArray m_batch;                /// two triangles per tile, empty tiles collapsed
 
   /**
-   * Load grid from file
-   * @param filename name of file
+   * Get word index and bit of a tile in the bitboards
+   * Column x is stored at bit x + 2 of its row so the columns either side of
+   * the grid always read as empty
+   * @param x x grid value
+   * @param y y grid value
+   * @return pair of word index and bit mask
    */
-  void Load(const std::string &filename)
+  std::pair<size_t, uint64_t> BitOf(int x, int y) const {
+    int bit = x + 2;
+    return {static_cast<size_t>(y * m_row_words + (bit >> 6)), uint64_t{1} << (bit & 63)};
+  }
+
+  /**
+   * Read the three columns x - 1, x, x + 1 of a bitboard row
+   * @param board bitboard
+   * @param x x grid value, at most one column outside the grid
+   * @param y y grid value inside the grid
+   * @return 3-bit mask
+   */
+  uint16_t ReadRow3(const std::pmr::vector<uint64_t> &board, int x, int y) const {
+    int bit = x + 1;
+    size_t word = y * m_row_words + (bit >> 6);
+    int shift = bit & 63;
+    uint64_t bits = board[word] >> shift;
+    if (shift > 61 && (bit >> 6) + 1 < m_row_words) {
+      bits |= board[word + 1] << (64 - shift);
+    }
+    return static_cast<uint16_t>(bits & 0b111);
+  }
+
+  /**
+   * Get mask of columns [x0, x1] that falls in a bitboard word
+   * @param word word index inside the row
+   * @param x0 first column
+   * @param x1 last column
+   * @return mask of bits
+   */
+  static uint64_t ColumnMask(int word, int x0, int x1) {
+    int lo = std::max(x0 + 2 - word * 64, 0);
+    int hi = std::min(x1 + 2 - word * 64, 63);
+    if (lo > hi) return 0;
+    uint64_t upper = (hi == 63) ? ~uint64_t{0} : (uint64_t{1} << (hi + 1)) - 1;
+    return upper & ~((uint64_t{1} << lo) - 1);
+  }
+
+  /**
+   * Write the two triangles of a tile into the render batch
+   * Matches the shape Block draws for the same tile
+   * @param id ID
+   * @param tile tile ID, 0 to collapse the tile
+   */
+  void UpdateBatch(uint32_t id, uint8_t tile) {
+    sf::Vertex *quad = &m_batch[id * 6];
+    if (tile == 0) {
+      for (int i = 0; i < 6; i++) quad[i].position = {0, 0};
+      return;
+    }
+
+    sf::Vector2f top_left = {static_cast<float>((id % m_width) * BLOCK_SIZE_TOTAL + BLOCK_SPACING),
+                             static_cast<float>((id / m_width) * BLOCK_SIZE_TOTAL + BLOCK_SPACING)};
+    sf::Vector2f bottom_right = top_left + sf::Vector2f(BLOCK_SIZE, BLOCK_SIZE);
+    quad[0].position = top_left;
+    quad[1].position = {bottom_right.x, top_left.y};
+    quad[2].position = {top_left.x, bottom_right.y};
+    quad[3].position = {top_left.x, bottom_right.y};
+    quad[4].position = {bottom_right.x, top_left.y};
+    quad[5].position = bottom_right;
+    sf::Color color = Block::ColorOf(tile);
+    for (int i = 0; i < 6; i++) quad[i].color = color;
+  }
+
+  /**
+   * Place block at ID, keeping bitboards and render batch in sync
+   * @param id ID
+   * @param tile tile ID of block
+   */
+  void Place(uint32_t id, uint8_t tile) {
+    if (id >= static_cast<uint32_t>(m_width * m_height)) return;
+    auto [word, bit] = BitOf(id % m_width, id / m_width);
+    m_occupied[word] |= bit;
+    if (Block::BreakableOf(tile)) {
+      m_breakable[word] |= bit;
+    } else {
+      m_breakable[word] &= ~bit;
+    }
+    UpdateBatch(id, tile);
+    m_tiles[id] = tile;
+  }
+
+  /**
+   * Build grid from tile IDs, replacing all contents
+   * @param width width of grid
+   * @param height height of grid
+   * @param tiles tile IDs, row major
+   */
+  void Build(int width, int height, const uint8_t *tiles)
   {
-    std::ifstream file(filename);
-    uint8_t read_width, read_height;
-    file >> read_width >> read_height;
-    m_width = read_width;
-    m_height = read_height;
-
-    for (uint32_t i = 0; i < m_width * m_height; i += 2) {
-      uint8_t data_pair, id_1, id_2;
-      file >> data_pair;
-      id_1 = (data_pair >> 4);
-      id_2 = (data_pair & 0b00001111);
-
-      if (id_1 != 0) {
-        m_blocks[i] = std::make_shared<Block>(i % m_width, i / m_width, id_1);
-        if (id_1 != 0 && id_1 != 8) m_breakable_blocks++;
-      }
+    TRACE_ZONE("Grid::Build");
+    m_width = width;
+    m_height = height;
+    m_row_words = (m_width + 4 + 63) / 64;
+    m_tiles.assign(m_width * m_height, 0);
+    m_occupied.assign(m_row_words * m_height, 0);
+    m_breakable.assign(m_row_words * m_height, 0);
+    m_batch.setPrimitiveType(sf::PrimitiveType::Triangles);
+    m_batch.resize(m_width * m_height * 6);
 
-      if (id_2 != 0) {
-        m_blocks[i + 1] = std::make_shared<Block>((i + 1) % m_width, (i + 1) / m_width, id_2);
-        if (id_2 != 0 && id_2 != 8) m_breakable_blocks++;
+    for (uint32_t i = 0; i < m_tiles.size(); i++) {
+      if (tiles[i] != 0) {
+        Place(i, tiles[i]);
+      } else {
+        UpdateBatch(i, 0);
       }
     }
   }
@@ -52,20 +148,158 @@ public:
     /**
      * Default constructor
      * @param filename name of file to load data from
+     * @param resource allocator for tiles and bitboards
      */
-    Grid(const std::string &filename) {
+    Grid(const std::string &filename, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : m_tiles(resource), m_occupied(resource), m_breakable(resource) {
       m_origin = {0, 0};
       Load(filename);
     }
 
+    /**
+     * Construct from tile IDs
+     * @param width width of grid
+     * @param height height of grid
+     * @param tiles tile IDs, row major
+     * @param resource allocator for tiles and bitboards
+     */
+    Grid(int width, int height, const uint8_t *tiles,
+         std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : m_tiles(resource), m_occupied(resource), m_breakable(resource) {
+      m_origin = {0, 0};
+      Build(width, height, tiles);
+    }
+
+    /**
+     * Load grid from file, replacing all contents
+     * @param filename name of file
+     */
+    void Load(const std::string &filename)
+    {
+      TRACE_ZONE("Grid::Load");
+      METRIC_TIMER(level_load_us);
+      int width = 0;
+      int height = 0;
+      std::vector<uint8_t> tiles;
+      ReadLevel(filename, width, height, tiles);
+      Build(width, height, tiles.data());
+    }
+
+    /**
+     * Empty the grid and free its storage
+     */
+    void Clear() {
+      m_width = 0;
+      m_height = 0;
+      m_row_words = 0;
+      m_tiles = std::pmr::vector<uint8_t>(m_tiles.get_allocator());
+      m_occupied = std::pmr::vector<uint64_t>(m_occupied.get_allocator());
+      m_breakable = std::pmr::vector<uint64_t>(m_breakable.get_allocator());
+      m_batch.clear();
+    }
+
     /**
      * Draw grid to window
      * @param window window to draw on
      */
     void Draw(sf::RenderWindow &window) const {
-      for (const auto &block : m_blocks) {
-        block.second->Draw(window);
+      TRACE_ZONE("Grid::Draw");
+      window.draw(m_batch);
+    }
+
+    /**
+     * Set grid to tile IDs, touching only tiles that changed
+     * Rebuilds the grid if the dimensions changed
+     * @param width width of grid
+     * @param height height of grid
+     * @param tiles tile IDs, row major
+     * @return number of tiles changed
+     */
+    uint32_t ApplyTiles(int width, int height, const uint8_t *tiles) {
+      TRACE_ZONE("Grid::ApplyTiles");
+      if (width != m_width || height != m_height) {
+        Build(width, height, tiles);
+        return m_tiles.size();
       }
+
+      uint32_t changed = 0;
+      for (uint32_t i = 0; i < m_tiles.size(); i++) {
+        if (m_tiles[i] == tiles[i]) continue;
+
+        changed++;
+        if (tiles[i] == 0) {
+          Remove(i);
+        } else {
+          Place(i, tiles[i]);
+        }
+      }
+
+      return changed;
+    }
+
+    /**
+     * Reload grid from file, touching only tiles that changed
+     * @param filename name of file to load data from
+     * @return number of tiles changed
+     */
+    uint32_t Reload(const std::string &filename) {
+      TRACE_ZONE("Grid::Reload");
+      METRIC_TIMER(level_load_us);
+      int width, height;
+      std::vector<uint8_t> tiles;
+      if (!ReadLevel(filename, width, height, tiles)) return 0;
+      return ApplyTiles(width, height, tiles.data());
+    }
+
+    /**
+     * Get tile ID at grid position
+     * @param x x grid value
+     * @param y y grid value
+     * @return tile ID, 0 if empty or outside the grid
+     */
+    uint8_t GetTile(int x, int y) const {
+      if (x < 0 || x >= m_width || y < 0 || y >= m_height) return 0;
+      return m_tiles[GetTileID(x, y)];
+    }
+
+    /**
+     * Set tile at grid position, keeping collision data and render batch in sync
+     * Positions outside the grid are ignored
+     * @param x x grid value
+     * @param y y grid value
+     * @param tile tile ID, 0 to clear
+     */
+    void SetTile(int x, int y, uint8_t tile) {
+      if (x < 0 || x >= m_width || y < 0 || y >= m_height) return;
+      if (tile == 0) {
+        Remove(GetTileID(x, y));
+      } else {
+        Place(GetTileID(x, y), tile);
+      }
+    }
+
+    /**
+     * Get tile IDs
+     * @return tile ID per cell, row major, 0 if empty
+     */
+    const std::pmr::vector<uint8_t> &GetTiles() const {
+      return m_tiles;
+    }
+
+    /**
+     * Get width of grid
+     * @return width in tiles
+     */
+    int GetWidth() const {
+      return m_width;
+    }
+
+    /**
+     * Get height of grid
+     * @return height in tiles
+     */
+    int GetHeight() const {
+      return m_height;
     }
 
     /**
@@ -77,28 +311,68 @@ public:
     }
 
     /**
-     * Get subset of blocks around position
-     * @param pos position
-     * @return subset of blocks
+     * Get occupancy of the 3x3 neighbourhood around a cell
+     * Cells outside the grid count as empty
+     * @param x x grid value
+     * @param y y grid value
+     * @return 9-bit mask, bit (dy + 1) * 3 + (dx + 1) set if occupied
      */
-    block_map GetSubset(const sf::Vector2f &pos) {
-      block_map subset;
-      int x = static_cast<int>(pos.x / BLOCK_SIZE_TOTAL);
-      int y = static_cast<int>(pos.y / BLOCK_SIZE_TOTAL);
+    uint16_t GetNeighbourhood(int x, int y) const {
+      if (x < -1 || x > m_width) return 0;
+      uint16_t mask = 0;
 
       for (int dy = -1; dy < 2; dy++) {
         if (y + dy < 0 || y + dy >= m_height) continue;
-
-        for (int dx = -1; dx < 2; dx++) {
-          if (x + dx < 0 || x + dx >= m_width) continue;
-          uint32_t id = (x + dx) + (y + dy) * m_width;
-          if (m_blocks.contains(id)) {
-            subset[id] = m_blocks[id];
-          }
-        }
+        mask |= ReadRow3(m_occupied, x, y + dy) << ((dy + 1) * 3);
       }
 
-      return subset;
+      return mask;
+    }
+
+    /**
+     * Get occupancy bitboard, rows of GetRowWords() words with column x at
+     * bit x + 2 of its row
+     * @return occupancy bitboard
+     */
+    const std::pmr::vector<uint64_t> &GetOccupancy() const {
+      return m_occupied;
+    }
+
+    /**
+     * Get breakable-only bitboard, same layout as GetOccupancy()
+     * @return breakable bitboard
+     */
+    const std::pmr::vector<uint64_t> &GetBreakableBoard() const {
+      return m_breakable;
+    }
+
+    /**
+     * Get number of 64-bit words per bitboard row
+     * @return words per row
+     */
+    int GetRowWords() const {
+      return m_row_words;
+    }
+
+    /**
+     * Get ID of tile at grid position
+     * @param x x grid value
+     * @param y y grid value
+     * @return ID
+     */
+    uint32_t GetTileID(int x, int y) const {
+      return x + y * m_width;
+    }
+
+    /**
+     * Check if there is a breakable block at ID
+     * @param id ID
+     * @return true if block exists and is breakable
+     */
+    bool IsBreakable(uint32_t id) const {
+      if (id >= static_cast<uint32_t>(m_width * m_height)) return false;
+      auto [word, bit] = BitOf(id % m_width, id / m_width);
+      return (m_breakable[word] & bit) != 0;
     }
 
     /**
@@ -106,8 +380,68 @@ public:
      * @param id ID
      */
     void Remove(uint32_t id) {
-      m_blocks.erase(id);
-      m_breakable_blocks--;
+      if (id >= static_cast<uint32_t>(m_width * m_height)) return;
+      auto [word, bit] = BitOf(id % m_width, id / m_width);
+      m_occupied[word] &= ~bit;
+      m_breakable[word] &= ~bit;
+      UpdateBatch(id, 0);
+      m_tiles[id] = 0;
+    }
+
+    /**
+     * Remove all breakable blocks in a region
+     * @param x0 first column
+     * @param y0 first row
+     * @param x1 last column
+     * @param y1 last row
+     * @return number of blocks removed
+     */
+    uint32_t ClearRegion(int x0, int y0, int x1, int y1) {
+      x0 = std::max(x0, 0);
+      y0 = std::max(y0, 0);
+      x1 = std::min(x1, m_width - 1);
+      y1 = std::min(y1, m_height - 1);
+      uint32_t removed = 0;
+
+      for (int y = y0; y <= y1; y++) {
+        for (int w = 0; w < m_row_words; w++) {
+          size_t word = y * m_row_words + w;
+          uint64_t bits = m_breakable[word] & ColumnMask(w, x0, x1);
+          if (bits == 0) continue;
+
+          m_occupied[word] &= ~bits;
+          m_breakable[word] &= ~bits;
+          removed += std::popcount(bits);
+          for (; bits != 0; bits &= bits - 1) {
+            uint32_t id = GetTileID(w * 64 + std::countr_zero(bits) - 2, y);
+            UpdateBatch(id, 0);
+            m_tiles[id] = 0;
+          }
+        }
+      }
+
+      return removed;
+    }
+
+    /**
+     * Remove all breakable blocks in a row
+     * @param y row
+     * @return number of blocks removed
+     */
+    uint32_t ClearRow(int y) {
+      return ClearRegion(0, y, m_width - 1, y);
+    }
+
+    /**
+     * Count breakable blocks left in the grid
+     * @return number of breakable blocks
+     */
+    uint32_t BlocksRemaining() const {
+      uint32_t count = 0;
+      for (uint64_t word : m_breakable) {
+        count += std::popcount(word);
+      }
+      return count;
     }
 
     /**
@@ -115,6 +449,9 @@ public:
      * @return true if game is finished
      */
     bool Finished() const {
-      return (m_breakable_blocks == 0);
+      for (uint64_t word : m_breakable) {
+        if (word != 0) return false;
+      }
+      return true;
     }
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Read tile IDs from level file
+ * Files are a width byte, a height byte, then two 4-bit tile IDs per byte
+ * @param filename name of file
+ * @param width width of grid reference
+ * @param height height of grid reference
+ * @param tiles tile IDs reference, row major
+ * @return true if header could be read
+ */
+inline bool ReadLevel(const std::string &filename,
+                      int &width,
+                      int &height,
+                      std::vector<uint8_t> &tiles)
+{
+  std::ifstream file(filename, std::ios::binary);
+  file >> std::noskipws;
+  uint8_t read_width, read_height;
+  if (!(file >> read_width >> read_height)) return false;
+  width = read_width;
+  height = read_height;
+
+  tiles.assign(width * height, 0);
+  for (size_t i = 0; i < tiles.size(); i += 2) {
+    uint8_t data_pair;
+    if (!(file >> data_pair)) break;
+    tiles[i] = (data_pair >> 4);
+    if (i + 1 < tiles.size()) tiles[i + 1] = (data_pair & 0b00001111);
+  }
+
+  return true;
+}
+
+/**
+ * Write tile IDs to level file in the format ReadLevel expects
+ * @param filename name of file
+ * @param width width of grid, at most 255
+ * @param height height of grid, at most 255
+ * @param tiles tile IDs, row major
+ * @return true if written
+ */
+inline bool WriteLevel(const std::string &filename,
+                       int width,
+                       int height,
+                       const std::vector<uint8_t> &tiles)
+{
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) return false;
+  file << static_cast<uint8_t>(width) << static_cast<uint8_t>(height);
+  for (size_t i = 0; i < tiles.size(); i += 2) {
+    uint8_t data_pair = (tiles[i] << 4);
+    if (i + 1 < tiles.size()) data_pair |= (tiles[i + 1] & 0b00001111);
+    file << data_pair;
+  }
+  return file.good();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Watches a level file for changes using inotify
+ * The containing directory is watched rather than the file itself, so saves
+ * that replace the file are picked up as well as saves that rewrite it.
+ * On platforms without inotify the watcher never reports a change.
+ */
+class LevelWatcher {
+private:
+  int m_fd = -1;          /// inotify instance
+  std::string m_name;     /// file name without directory
+
+public:
+  /**
+   * Default constructor
+   * @param filename name of level file to watch
+   */
+  LevelWatcher(const std::string &filename) {
+    size_t slash = filename.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : filename.substr(0, slash);
+    m_name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+
+#ifdef __linux__
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd >= 0 && inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+      close(m_fd);
+      m_fd = -1;
+    }
+#endif
+  }
+
+  LevelWatcher(const LevelWatcher &) = delete;
+  LevelWatcher &operator=(const LevelWatcher &) = delete;
+
+  /**
+   * Destructor
+   */
+  ~LevelWatcher() {
+#ifdef __linux__
+    if (m_fd >= 0) close(m_fd);
+#endif
+  }
+
+  /**
+   * Drain pending events without blocking
+   * @return true if the level file was written since the last call
+   */
+  bool Changed() {
+    bool changed = false;
+#ifdef __linux__
+    if (m_fd < 0) return false;
+
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(m_fd, buffer, sizeof(buffer))) > 0) {
+      for (char *ptr = buffer; ptr < buffer + length;) {
+        auto *event = reinterpret_cast<inotify_event *>(ptr);
+        if (event->len > 0 && m_name == event->name) changed = true;
+        ptr += sizeof(inotify_event) + event->len;
+      }
+    }
+#endif
+    return changed;
+  }
+};
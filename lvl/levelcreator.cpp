@@ -175,7 +175,13 @@ int main(int argc, char **argv) {
       sf::Vector2i grid_pos = {static_cast<int>(cursor_pos.x / BLOCK_SIZE_TOTAL),
                                static_cast<int>(cursor_pos.y / BLOCK_SIZE_TOTAL)};
       if (grid_pos.x < width && grid_pos.x >= 0) {
-        grid[grid_pos.y * width + grid_pos.x] = std::make_shared<Block>(grid_pos.x, grid_pos.y, cursor.GetID());
+        // repaint in place, holding the brush must not allocate every frame
+        std::shared_ptr<Block> &block = grid[grid_pos.y * width + grid_pos.x];
+        if (!block) {
+          block = std::make_shared<Block>(grid_pos.x, grid_pos.y, cursor.GetID());
+        } else if (block->GetID() != cursor.GetID()) {
+          block->SetID(cursor.GetID());
+        }
       }
     }
 
@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SFML/Graphics.hpp"
+#include "../constants.h"
+#include "../game.h"
+#include "../level.h"
+#include "../trace.h"
+
+enum class symmetry_type {NONE, MIRROR, QUAD};
+enum class pattern_type {ROWS, COLUMNS, CHECKER, RINGS, NOISE, MIX};
+
+/**
+ * Generator settings, set from program arguments
+ */
+struct gen_params {
+  int width = GRID_WIDTH;                   /// level width in tiles
+  int height = 40;                          /// level height in tiles
+  float density = 0.7f;                     /// chance a play area tile is filled
+  float unbreakable = 0.05f;                /// chance a filled tile is unbreakable
+  int gap = 16;                             /// width of the opening in the bottom wall
+  symmetry_type symmetry = symmetry_type::MIRROR;
+  pattern_type pattern = pattern_type::MIX;
+  std::vector<uint8_t> colors = {1, 2, 3, 4, 5, 6, 7};
+  uint64_t seed = GAME_SEED;                /// pack seed, same seed gives same pack
+  int count = 100;                          /// levels in the pack
+  int candidates = 8;                       /// candidates generated per round
+  int rounds = 4;                           /// most rounds of steering per level
+  float target = 0.5f;                      /// difficulty of first level, 0 easy to 1 hard
+  float target_end = -1;                    /// difficulty of last level, < 0 to keep target
+  uint64_t ticks = 20 * FRAME_RATE;         /// ticks each scoring game runs for
+  std::string out = "lvl/gen";              /// output directory
+};
+
+/**
+ * One generated level and its score
+ */
+struct candidate {
+  std::vector<uint8_t> tiles;   /// tile IDs, row major
+  float difficulty = 0;         /// mean struggle of the scoring players, see Score
+  float hardness = 0;           /// steering value it was generated with, see Steer
+};
+
+/**
+ * Search state of one level
+ */
+struct level_search {
+  float target = 0;             /// difficulty to reach
+  float hardness = 0;           /// steering value of the next round
+  float step = 0.25f;           /// hardness change after a missed round
+  int rounds = 0;               /// rounds run so far
+  bool done = false;            /// target reached or rounds used up
+  candidate best;               /// closest candidate so far
+};
+
+/// difficulty error accepted without another round
+const float TARGET_TOLERANCE = 0.03f;
+/// difficulty error reported as a miss
+const float TARGET_MISS = 0.1f;
+/// unbreakable ratio at full hardness
+const float HARD_UNBREAKABLE = 0.6f;
+/// smallest level side that leaves room for the frame and the play area
+const int MIN_LEVEL_SIZE = 12;
+/// rows above the ball's starting position, taller levels would cover it
+const int MAX_LEVEL_HEIGHT = (PLAYER_Y - BALL_RADIUS) / BLOCK_SIZE_TOTAL - 1;
+
+/**
+ * Small deterministic generator so candidates can be built on any thread
+ */
+struct gen_rng {
+  uint64_t state;
+
+  /**
+   * Get next value (splitmix64)
+   * @return random value
+   */
+  uint64_t Next() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  /**
+   * Get value in [0, 1)
+   * @return random value
+   */
+  float Unit() {
+    return (Next() >> 40) * (1.0f / (1 << 24));
+  }
+};
+
+/**
+ * Pick a colour for a tile from the pattern
+ * @param params generator settings
+ * @param pattern pattern to use, never MIX
+ * @param x x grid value
+ * @param y y grid value
+ * @param shift per level offset into the colour list
+ * @param rng random generator
+ * @return tile ID
+ */
+uint8_t PatternColor(const gen_params &params, pattern_type pattern, int x, int y, int shift, gen_rng &rng) {
+  int index = 0;
+  switch (pattern) {
+    case pattern_type::ROWS:
+      index = y / 2;
+      break;
+    case pattern_type::COLUMNS:
+      index = x / 4;
+      break;
+    case pattern_type::CHECKER:
+      index = (x / 4 + y / 2) % 2;
+      break;
+    case pattern_type::RINGS: {
+      float dx = (x - params.width * 0.5f) / 2;
+      float dy = y - params.height * 0.5f;
+      index = static_cast<int>(std::sqrt(dx * dx + dy * dy) / 3);
+      break;
+    }
+    default:
+      index = rng.Next() % params.colors.size();
+      break;
+  }
+  return params.colors[(index + shift) % params.colors.size()];
+}
+
+/**
+ * Bias the generator settings toward easier or harder levels
+ * Half hardness keeps the requested settings. Lower values widen the bottom
+ * opening and drop unbreakable tiles, which lets balls out to the paddle and
+ * blocks break quickly. Higher values fill the play area and add unbreakable
+ * tiles, so fewer blocks break in the scoring time.
+ * @param params generator settings
+ * @param hardness 0 easiest to 1 hardest
+ * @return steered settings
+ */
+gen_params Steer(const gen_params &params, float hardness) {
+  gen_params steered = params;
+  if (hardness < 0.5f) {
+    float t = 1.0f - 2.0f * hardness;
+    int widest = std::max(params.gap, params.width - 2);
+    steered.gap = params.gap + static_cast<int>(t * (widest - params.gap));
+    steered.unbreakable = params.unbreakable * (1.0f - t);
+  } else {
+    float t = 2.0f * hardness - 1.0f;
+    steered.density = params.density + t * (1.0f - params.density);
+    steered.unbreakable = params.unbreakable + t * std::max(0.0f, HARD_UNBREAKABLE - params.unbreakable);
+  }
+  return steered;
+}
+
+/**
+ * Generate one candidate level
+ * Levels keep the layout of the hand made ones: an unbreakable frame with
+ * an opening above the paddle, a play area inset by a few tiles and empty
+ * rows at the bottom for the ball to come back through.
+ * @param params generator settings
+ * @param seed candidate seed
+ * @return tile IDs, row major
+ */
+std::vector<uint8_t> Generate(const gen_params &params, uint64_t seed) {
+  gen_rng rng{seed};
+  int width = params.width;
+  int height = params.height;
+  std::vector<uint8_t> tiles(width * height, 0);
+
+  // frame, opening centered on the bottom wall
+  int gap_start = (width - params.gap) / 2;
+  for (int x = 0; x < width; x++) {
+    tiles[x] = 8;
+    if (x < gap_start || x >= gap_start + params.gap) tiles[(height - 1) * width + x] = 8;
+  }
+  for (int y = 0; y < height; y++) {
+    tiles[y * width] = 8;
+    tiles[y * width + width - 1] = 8;
+  }
+
+  // vary each candidate around the requested settings
+  float density = std::clamp(params.density + (rng.Unit() - 0.5f) * 0.3f, 0.05f, 1.0f);
+  float unbreakable = std::clamp(params.unbreakable * (0.5f + rng.Unit()), 0.0f, 1.0f);
+  pattern_type pattern = params.pattern;
+  if (pattern == pattern_type::MIX) pattern = static_cast<pattern_type>(rng.Next() % 5);
+  int shift = rng.Next() % params.colors.size();
+
+  // fill the canonical part of the play area, then mirror it
+  int x0 = 4, x1 = width - 5;
+  int y0 = 4, y1 = height - 5;
+  int x_end = (params.symmetry == symmetry_type::NONE) ? x1 : (x0 + x1) / 2;
+  int y_end = (params.symmetry == symmetry_type::QUAD) ? (y0 + y1) / 2 : y1;
+  for (int y = y0; y <= y_end; y++) {
+    for (int x = x0; x <= x_end; x++) {
+      if (rng.Unit() >= density) continue;
+      uint8_t id = (rng.Unit() < unbreakable) ? 8 : PatternColor(params, pattern, x, y, shift, rng);
+      tiles[y * width + x] = id;
+      if (params.symmetry != symmetry_type::NONE) {
+        tiles[y * width + (x0 + x1 - x)] = id;
+      }
+      if (params.symmetry == symmetry_type::QUAD) {
+        tiles[(y0 + y1 - y) * width + x] = id;
+        tiles[(y0 + y1 - y) * width + (x0 + x1 - x)] = id;
+      }
+    }
+  }
+
+  return tiles;
+}
+
+/**
+ * Paddle policy for a player with a limited hand speed
+ * @param speed largest paddle move per tick, in pixels
+ * @param offset ball offset from paddle center, in pixels
+ * @return policy
+ */
+paddle_policy LimitedPlayer(float speed, float offset) {
+  return [speed, offset](const Game &game) {
+    float paddle = game.GetPlayer().GetPosition().x;
+    const game_ball *lowest = nullptr;
+    for (const game_ball &ball : game.GetBalls()) {
+      if (lowest == nullptr || ball.GetPosition().y > lowest->GetPosition().y) {
+        lowest = &ball;
+      }
+    }
+    if (lowest == nullptr) return paddle;
+    return paddle + std::clamp(lowest->GetPosition().x - offset - paddle, -speed, speed);
+  };
+}
+
+/**
+ * Score a level by playing it with a spread of simulated players
+ * Scoring games are far too short to clear a level, so each player is
+ * judged on how early they lose and how slowly they break blocks against
+ * a pace of one block per second. Difficulty is the mean over players.
+ * @param params generator settings
+ * @param tiles tile IDs
+ * @param players paddle policies to play with
+ * @return difficulty, 0 easy to 1 hard
+ */
+float Score(const gen_params &params, const std::vector<uint8_t> &tiles, const std::vector<paddle_policy> &players) {
+  float pace = static_cast<float>(params.ticks) / FRAME_RATE;
+  float struggle = 0;
+  for (const paddle_policy &player : players) {
+    Game game(params.width, params.height, tiles.data());
+    uint32_t total = game.GetGrid().BlocksRemaining();
+    while (game.GetTick() < params.ticks && !game.Lost() && !game.Won()) {
+      game.Step(player(game));
+    }
+    if (game.Won()) continue;
+
+    float lost_early = game.Lost() ? 1.0f - static_cast<float>(game.GetTick()) / params.ticks : 0;
+    float broken = total - game.GetGrid().BlocksRemaining();
+    struggle += 0.5f * lost_early + 0.5f * pace / (pace + broken);
+  }
+  return struggle / players.size();
+}
+
+/**
+ * Parse program arguments into generator settings
+ * @param argc argument count
+ * @param argv arguments
+ * @param params settings reference
+ * @return true if every argument was understood
+ */
+bool ParseArgs(int argc, char **argv, gen_params &params) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key(argv[i]);
+    std::string value(argv[i + 1]);
+    if (key == "--width") params.width = std::stoi(value);
+    else if (key == "--height") params.height = std::stoi(value);
+    else if (key == "--density") params.density = std::stof(value);
+    else if (key == "--unbreakable") params.unbreakable = std::stof(value);
+    else if (key == "--gap") params.gap = std::stoi(value);
+    else if (key == "--seed") params.seed = std::stoull(value);
+    else if (key == "--count") params.count = std::stoi(value);
+    else if (key == "--candidates") params.candidates = std::stoi(value);
+    else if (key == "--rounds") params.rounds = std::stoi(value);
+    else if (key == "--target") params.target = std::stof(value);
+    else if (key == "--target-end") params.target_end = std::stof(value);
+    else if (key == "--ticks") params.ticks = std::stoull(value);
+    else if (key == "--out") params.out = value;
+    else if (key == "--symmetry") {
+      if (value == "none") params.symmetry = symmetry_type::NONE;
+      else if (value == "mirror") params.symmetry = symmetry_type::MIRROR;
+      else if (value == "quad") params.symmetry = symmetry_type::QUAD;
+      else return false;
+    } else if (key == "--pattern") {
+      const std::string names[] = {"rows", "columns", "checker", "rings", "noise", "mix"};
+      auto found = std::find(std::begin(names), std::end(names), value);
+      if (found == std::end(names)) return false;
+      params.pattern = static_cast<pattern_type>(found - std::begin(names));
+    } else if (key == "--colors") {
+      params.colors.clear();
+      for (char c : value) {
+        if (c < '1' || c > '7') return false;
+        params.colors.push_back(c - '0');
+      }
+    } else {
+      return false;
+    }
+  }
+
+  return (argc % 2 == 1) && !params.colors.empty() && params.count > 0 && params.candidates > 0 &&
+         params.rounds > 0 &&
+         params.width >= MIN_LEVEL_SIZE && params.width <= GRID_WIDTH &&
+         params.height >= MIN_LEVEL_SIZE && params.height <= MAX_LEVEL_HEIGHT &&
+         params.gap >= 0 && params.gap <= params.width;
+}
+
+/**
+ * Main function
+ * Generates a pack of levels, scoring candidates with headless games
+ * spread over every core. Each round generates candidates for every level
+ * still searching, then moves that level's hardness toward its target
+ * difficulty, halving the step each time, until a candidate is close
+ * enough or the rounds run out. Levels that end far from their target are
+ * reported, as the scoring players cannot reach every difficulty.
+ * @return success
+ */
+int main(int argc, char **argv) {
+  gen_params params;
+  if (!ParseArgs(argc, argv, params)) {
+    std::cerr << "Usage: levelgen [--count n] [--candidates n] [--rounds n] [--seed n] [--width n] [--height n]\n"
+                 "                [--density 0-1] [--unbreakable 0-1] [--gap n]\n"
+                 "                [--symmetry none|mirror|quad]\n"
+                 "                [--pattern rows|columns|checker|rings|noise|mix] [--colors 1234567]\n"
+                 "                [--target 0-1] [--target-end 0-1] [--ticks n] [--out directory]\n"
+              << "Width is " << MIN_LEVEL_SIZE << " to " << GRID_WIDTH << " tiles, the window width, and height "
+              << MIN_LEVEL_SIZE << " to " << MAX_LEVEL_HEIGHT << " tiles, the rows above the paddle" << std::endl;
+    return 1;
+  }
+
+  TRACE_THREAD("main");
+  auto start = std::chrono::steady_clock::now();
+
+  // players from slow and central to quick and off center
+  std::vector<paddle_policy> players;
+  for (float speed : {3.0f, 6.0f, 12.0f}) {
+    for (float offset : {-0.5f, 0.25f}) {
+      players.push_back(LimitedPlayer(speed, offset * (PLAYER_HALF_WIDTH - BALL_RADIUS)));
+    }
+  }
+
+  std::vector<level_search> levels(params.count);
+  float target_end = (params.target_end < 0) ? params.target : params.target_end;
+  for (int level = 0; level < params.count; level++) {
+    float target = params.target;
+    if (params.count > 1) target += (target_end - params.target) * level / (params.count - 1);
+    levels[level].target = target;
+    levels[level].hardness = std::clamp(target, 0.0f, 1.0f);
+  }
+
+  // every candidate of every searching level is an independent job, seeded
+  // by level, round and index so the pack does not depend on the threads
+  size_t workers = std::max(1u, std::thread::hardware_concurrency());
+  size_t total = 0;
+  std::vector<candidate> results;
+  std::vector<size_t> owners;
+  for (int round = 0; round < params.rounds; round++) {
+    owners.clear();
+    for (int level = 0; level < params.count; level++) {
+      if (!levels[level].done) owners.push_back(level);
+    }
+    if (owners.empty()) break;
+
+    size_t jobs = owners.size() * params.candidates;
+    results.assign(jobs, candidate{});
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < std::min(workers, jobs); w++) {
+      threads.emplace_back([&, w]() {
+        TRACE_THREAD("levelgen worker " + std::to_string(w));
+        for (size_t i = w; i < jobs; i += std::min(workers, jobs)) {
+          TRACE_ZONE("Candidate");
+          size_t level = owners[i / params.candidates];
+          uint64_t index = (static_cast<uint64_t>(level) * params.rounds + round) * params.candidates +
+                           i % params.candidates;
+          results[i].hardness = levels[level].hardness;
+          results[i].tiles = Generate(Steer(params, results[i].hardness), gen_rng{params.seed + index}.Next());
+          results[i].difficulty = Score(params, results[i].tiles, players);
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    total += jobs;
+
+    // keep the closest candidate, then steer toward the target
+    for (size_t o = 0; o < owners.size(); o++) {
+      level_search &search = levels[owners[o]];
+      for (int c = 0; c < params.candidates; c++) {
+        candidate &option = results[o * params.candidates + c];
+        if (search.rounds == 0 ||
+            std::abs(option.difficulty - search.target) < std::abs(search.best.difficulty - search.target)) {
+          search.best = std::move(option);
+        }
+      }
+      search.rounds++;
+      float error = search.target - search.best.difficulty;
+      search.hardness = std::clamp(search.hardness + std::copysign(search.step, error), 0.0f, 1.0f);
+      search.step *= 0.5f;
+      search.done = std::abs(error) <= TARGET_TOLERANCE || search.rounds == params.rounds;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(params.out, error);
+  int misses = 0;
+  for (int level = 0; level < params.count; level++) {
+    const level_search &search = levels[level];
+    char name[16];
+    std::snprintf(name, sizeof(name), "%03d.bin", level + 1);
+    std::string filename = params.out + "/" + name;
+    if (!WriteLevel(filename, params.width, params.height, search.best.tiles)) {
+      std::cerr << "Error writing file: " << filename << std::endl;
+      return 1;
+    }
+    std::cout << filename << ": difficulty " << search.best.difficulty << " (target " << search.target
+              << ", hardness " << search.best.hardness << ", rounds " << search.rounds << ")" << std::endl;
+    if (std::abs(search.best.difficulty - search.target) > TARGET_MISS) {
+      std::cerr << "Warning: " << filename << " misses its target by "
+                << std::abs(search.best.difficulty - search.target) << std::endl;
+      misses++;
+    }
+  }
+  if (misses > 0) {
+    std::cerr << "Warning: " << misses << " of " << params.count << " levels missed their target by more than "
+              << TARGET_MISS << ", the scoring players may not reach that difficulty" << std::endl;
+  }
+
+  auto finished = std::chrono::steady_clock::now();
+  std::cout << params.count << " levels from " << total << " candidates on " << workers << " threads in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(finished - start).count() << " ms" << std::endl;
+
+  TRACE_FLUSH("levelgen.trace.json");
+
+  return 0;
+}
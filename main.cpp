@@ -1,55 +1,39 @@
 #include <iostream>
-#include <fstream>
-#include <memory>
-#include <map>
-#include <set>
 #include "SFML/Graphics.hpp"
 
-#include "ball.h"
-#include "block.h"
 #include "constants.h"
-#include "grid.h"
-#include "player.h"
-
-/**
- * Multiply balls power up
- * @param balls set of currently active balls
- * @param ball_id current ball ID
- */
-void MultiplyBalls(std::map<uint32_t, std::shared_ptr<Ball>> &balls, uint32_t &ball_id) {
-  std::map<uint32_t, std::shared_ptr<Ball>> temp;
-  for (const auto &ball : balls) {
-    double angle = ball.second->GetAngle();
-    temp[ball_id++] = std::make_shared<Ball>(ball.second->GetPosition(), angle + 2.0f * M_PI / 3.0);
-    temp[ball_id++] = std::make_shared<Ball>(ball.second->GetPosition(), angle - 2.0f * M_PI / 3.0);
-  }
-
-  for (const auto &ball : temp) {
-    balls[ball.first] = ball.second;
-  }
-}
+#include "game.h"
+#include "level_watcher.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "trace.h"
 
 /**
  * Main function
+ * Metrics builds publish to shared memory, see Metrics::Init
+ * Trace builds write trace.json when T is pressed
+ * N restarts the level from scratch, M prints memory use per subsystem
  * @return success
  */
 int main() {
+  METRICS_INIT();
+  TRACE_THREAD("main");
   sf::RenderWindow window(sf::VideoMode({WINDOW_WIDTH, WINDOW_HEIGHT}), "Breakout");
   window.setFramerateLimit(FRAME_RATE);
 
-  Player player;
+  // init game and level
+  const std::string level = "lvl/001.bin";
+  Game game(level);
+  LevelWatcher watcher(level);
 
-  // init set of balls
-  std::map<uint32_t, std::shared_ptr<Ball>> balls;
-  uint32_t ball_id = 0;
-  balls[ball_id++] = std::make_shared<Ball>();
-  std::set<uint32_t> to_delete;
-
-  // init grid of blocks
-  Grid grid("lvl/001.bin");
+  // last few seconds of state, hold R to rewind
+  RewindBuffer rewind(REWIND_SECONDS * FRAME_RATE);
+  bool rewinding = false;
 
   // Game loop
   while (window.isOpen()) {
+    METRIC_FRAME();
+    TRACE_ZONE("Frame");
     sf::Event event;
     while (window.pollEvent(event)) {
       if (event.type == sf::Event::Closed) {
@@ -57,53 +41,63 @@ int main() {
       }
       if (event.type == sf::Event::MouseButtonPressed) {
         if (event.mouseButton.button == sf::Mouse::Button::Left) {
-          MultiplyBalls(balls, ball_id);
+          game.MultiplyBalls();
         }
       }
+      if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Key::R) {
+        rewinding = true;
+      }
+      if (event.type == sf::Event::KeyReleased && event.key.code == sf::Keyboard::Key::R) {
+        rewinding = false;
+      }
+      if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Key::T) {
+        TRACE_FLUSH("trace.json");
+      }
+      if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Key::N) {
+        game.Load(level);
+        rewind.Clear();
+      }
+      if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Key::M) {
+        std::cout << game.GetMemory().Report();
+      }
     }
 
-    // Deal with player
-    sf::Vector2i mouse_pos = sf::Mouse::getPosition(window);
-    player.Move(window.mapPixelToCoords(mouse_pos));
-
-    // Deal with balls
-    for (const auto &ball : balls) {
-      ball.second->Move();
-      ball.second->PlayerCollision(player);
-      ball.second->GridCollision(grid);
-
-      if (ball.second->OutOfBounds()) {
-        to_delete.insert(ball.first);
-      }
+    // pick up edits saved from the level creator
+    if (watcher.Changed()) {
+      game.Reload(level);
+      rewind.Clear();
     }
 
-    // delete balls if out of bounds
-    for (uint32_t id : to_delete) {
-      balls.erase(id);
+    if (rewinding) {
+      if (const Snapshot *snapshot = rewind.Pop()) {
+        game.Restore(*snapshot);
+      }
+    } else {
+      game.Save(rewind.Push());
+      sf::Vector2i mouse_pos = sf::Mouse::getPosition(window);
+      game.Step(window.mapPixelToCoords(mouse_pos).x);
     }
-    to_delete.clear();
 
     // draw step
     window.clear(BACKGROUND_COLOR);
-    player.Draw(window);
-    for (const auto &ball : balls) {
-      ball.second->Draw(window);
+    game.Draw(window);
+    {
+      TRACE_ZONE("Display");
+      window.display();
     }
-    grid.Draw(window);
-    window.display();
 
     // lose condition
-    if (balls.empty()) {
+    if (game.Lost()) {
       std::cout << "Game over!" << std::endl;
       window.close();
     }
 
     // win condition
-    if (grid.Finished()) {
+    if (game.Won()) {
       std::cout << "You win!" << std::endl;
       window.close();
     }
   }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+
+/**
+ * Allocation counters of one arena
+ */
+struct memory_stats {
+  uint64_t bytes = 0;          /// bytes handed out and not yet returned
+  uint64_t peak = 0;           /// most bytes handed out at once
+  uint64_t allocations = 0;    /// allocations since the last reset
+  uint64_t deallocations = 0;  /// deallocations since the last reset
+  uint64_t reserved = 0;       /// bytes the arena holds from the system
+  uint64_t reserved_peak = 0;  /// most bytes held from the system at once
+};
+
+/**
+ * Arena class
+ * Pool allocator for one subsystem that counts everything going through
+ * it. Freed blocks are reused by the pool, and Reset hands the pool's
+ * memory back once the subsystem has freed everything, which the game
+ * does on level change.
+ * Not thread safe; every Game owns its own arenas.
+ */
+class Arena : public std::pmr::memory_resource {
+private:
+  /**
+   * Upstream that tracks how much memory the pool holds from the system
+   */
+  class Upstream : public std::pmr::memory_resource {
+  private:
+    memory_stats &m_stats;  /// stats of the owning arena
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+      void *ptr = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+      m_stats.reserved += bytes;
+      m_stats.reserved_peak = std::max(m_stats.reserved_peak, m_stats.reserved);
+      return ptr;
+    }
+
+    void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+      m_stats.reserved -= bytes;
+      std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+
+  public:
+    explicit Upstream(memory_stats &stats) : m_stats(stats) {}
+  };
+
+  const char *m_name;                            /// subsystem name for reports
+  memory_stats m_stats;                          /// counters
+  Upstream m_upstream{m_stats};                  /// system memory
+  std::pmr::unsynchronized_pool_resource m_pool; /// size class pools
+
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    void *ptr = m_pool.allocate(bytes, alignment);
+    m_stats.bytes += bytes;
+    m_stats.peak = std::max(m_stats.peak, m_stats.bytes);
+    m_stats.allocations++;
+    return ptr;
+  }
+
+  void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+    m_pool.deallocate(ptr, bytes, alignment);
+    m_stats.bytes -= bytes;
+    m_stats.deallocations++;
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+public:
+  /**
+   * Default constructor
+   * @param name subsystem name, must be a string literal
+   */
+  explicit Arena(const char *name) : m_name(name), m_pool(&m_upstream) {}
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /**
+   * Start counting afresh for a new level
+   * Pool memory only goes back to the system if nothing is still allocated
+   * @return true if the pool was released
+   */
+  bool Reset() {
+    m_stats.peak = m_stats.bytes;
+    m_stats.reserved_peak = m_stats.reserved;
+    m_stats.allocations = 0;
+    m_stats.deallocations = 0;
+    if (m_stats.bytes != 0) return false;
+    m_pool.release();
+    m_stats.reserved_peak = m_stats.reserved;
+    return true;
+  }
+
+  /**
+   * Get subsystem name
+   * @return name
+   */
+  const char *GetName() const {
+    return m_name;
+  }
+
+  /**
+   * Get counters
+   * @return stats
+   */
+  const memory_stats &GetStats() const {
+    return m_stats;
+  }
+};
+
+enum class subsystem : uint8_t {GRID, BALLS, BODIES, SCRIPTS};
+
+const size_t SUBSYSTEM_COUNT = 4;
+
+/**
+ * Memory class
+ * One arena per game subsystem
+ */
+class Memory {
+private:
+  std::array<Arena, SUBSYSTEM_COUNT> m_arenas{Arena("grid"), Arena("balls"), Arena("bodies"), Arena("scripts")};
+
+public:
+  /**
+   * Get allocator for a subsystem
+   * @param owner subsystem
+   * @return memory resource
+   */
+  std::pmr::memory_resource *Get(subsystem owner) {
+    return &m_arenas[static_cast<size_t>(owner)];
+  }
+
+  /**
+   * Get arena of a subsystem
+   * @param owner subsystem
+   * @return arena
+   */
+  const Arena &GetArena(subsystem owner) const {
+    return m_arenas[static_cast<size_t>(owner)];
+  }
+
+  /**
+   * Reset every arena, see Arena::Reset
+   * @return true if every pool was released
+   */
+  bool Reset() {
+    bool released = true;
+    for (Arena &arena : m_arenas) {
+      released &= arena.Reset();
+    }
+    return released;
+  }
+
+  /**
+   * Get totals over all arenas
+   * Peaks are summed, so they bound the real combined peak from above
+   * @return stats
+   */
+  memory_stats Total() const {
+    memory_stats total;
+    for (const Arena &arena : m_arenas) {
+      const memory_stats &stats = arena.GetStats();
+      total.bytes += stats.bytes;
+      total.peak += stats.peak;
+      total.allocations += stats.allocations;
+      total.deallocations += stats.deallocations;
+      total.reserved += stats.reserved;
+      total.reserved_peak += stats.reserved_peak;
+    }
+    return total;
+  }
+
+  /**
+   * Format a table of bytes and allocation counts per subsystem
+   * Render batches live in SFML vertex arrays and are not counted
+   * @return report
+   */
+  std::string Report() const {
+    std::ostringstream out;
+    auto row = [&out](const char *name, const memory_stats &stats) {
+      out << std::left << std::setw(10) << name << std::right
+          << std::setw(12) << stats.bytes << std::setw(12) << stats.peak
+          << std::setw(12) << stats.reserved << std::setw(12) << stats.reserved_peak
+          << std::setw(10) << stats.allocations << std::setw(10) << stats.deallocations << "\n";
+    };
+
+    out << std::left << std::setw(10) << "subsystem" << std::right
+        << std::setw(12) << "live" << std::setw(12) << "peak"
+        << std::setw(12) << "reserved" << std::setw(12) << "res. peak"
+        << std::setw(10) << "allocs" << std::setw(10) << "frees" << "\n";
+    for (const Arena &arena : m_arenas) {
+      row(arena.GetName(), arena.GetStats());
+    }
+    row("total", Total());
+    return out.str();
+  }
+};
@@ -0,0 +1,39 @@
+#include "metrics.h"
+
+#ifdef BREAKOUT_METRICS
+
+#include <cstdlib>
+#include <new>
+
+/*
+ * Replacement allocation functions that count calls into the metrics block.
+ * Only the plain forms are replaced; the others forward to these by default.
+ */
+
+void *operator new(std::size_t size) {
+  METRIC_ADD(allocations, 1);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+#endif
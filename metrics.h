@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/// Frame time histogram sub-buckets per power of two, see Metrics::Bucket
+const int METRICS_FRAME_SUB_BITS = 3;
+const int METRICS_FRAME_SUB_BUCKETS = 1 << METRICS_FRAME_SUB_BITS;
+/// Frame time histogram buckets, covering frames up to 2^24 microseconds
+const int METRICS_FRAME_BUCKETS = (24 - METRICS_FRAME_SUB_BITS + 1) * METRICS_FRAME_SUB_BUCKETS;
+const uint64_t METRICS_MAGIC = 0x6B6F7574'6D657432ULL;
+const char *const METRICS_DEFAULT_SHM = "/breakout_metrics";
+
+/**
+ * Live metrics, laid out to be shared with a reader process
+ * Every field is updated with relaxed atomics; readers only ever see a
+ * slightly stale but never torn value per field. Counters only grow, so a
+ * reader gets rates from two samples and no history is kept here.
+ */
+struct metrics_block {
+  uint64_t magic = METRICS_MAGIC;
+  std::atomic<uint64_t> ticks{0};                     /// counter: simulation ticks
+  std::atomic<uint64_t> frames{0};                    /// counter: frames timed
+  std::atomic<uint64_t> frame_time_us[METRICS_FRAME_BUCKETS]{}; /// histogram
+  std::atomic<uint64_t> live_balls{0};                /// gauge: balls in play
+  std::atomic<uint64_t> collision_tests{0};           /// counter: tiles and bodies tested against balls
+  std::atomic<uint64_t> collision_tests_last_tick{0}; /// gauge: tiles and bodies tested in last tick
+  std::atomic<uint64_t> blocks_broken{0};             /// counter: blocks removed by balls
+  std::atomic<uint64_t> allocations{0};               /// counter: operator new calls
+  std::atomic<uint64_t> allocations_last_frame{0};    /// gauge: operator new calls in last frame
+  std::atomic<uint64_t> level_load_us{0};             /// gauge: last level load/reload time
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "metrics are shared between processes");
+
+/**
+ * Plain copy of a metrics block
+ */
+struct metrics_sample {
+  uint64_t ticks = 0;
+  uint64_t frames = 0;
+  uint64_t frame_time_us[METRICS_FRAME_BUCKETS] = {};
+  uint64_t live_balls = 0;
+  uint64_t collision_tests = 0;
+  uint64_t collision_tests_last_tick = 0;
+  uint64_t blocks_broken = 0;
+  uint64_t allocations = 0;
+  uint64_t allocations_last_frame = 0;
+  uint64_t level_load_us = 0;
+};
+
+/**
+ * Metrics class
+ * Hot paths go through the METRIC_* macros below, which compile to nothing
+ * unless BREAKOUT_METRICS is defined.
+ */
+class Metrics {
+private:
+  inline static metrics_block s_local;               /// used until published
+  inline static metrics_block *s_block = &s_local;   /// block being updated
+  inline static std::string s_file;                  /// exposition file, empty if off
+  inline static std::chrono::seconds s_interval{10}; /// exposition period
+  inline static std::chrono::steady_clock::time_point s_last_write;
+  inline static metrics_sample s_last_sample;        /// sample at last write, for rates
+  inline static uint64_t s_last_allocations = 0;     /// allocations at last frame
+
+  /**
+   * Get histogram bucket of a frame time
+   * Times under METRICS_FRAME_SUB_BUCKETS get a bucket each, every power
+   * of two above is split into METRICS_FRAME_SUB_BUCKETS equal buckets, so
+   * a bucket is at most 1/8 of its lower bound wide
+   * @param us frame time in microseconds
+   * @return bucket index
+   */
+  static int Bucket(uint64_t us) {
+    if (us < METRICS_FRAME_SUB_BUCKETS) return static_cast<int>(us);
+    int shift = std::bit_width(us) - 1 - METRICS_FRAME_SUB_BITS;
+    int bucket = (shift + 1) * METRICS_FRAME_SUB_BUCKETS + static_cast<int>((us >> shift) - METRICS_FRAME_SUB_BUCKETS);
+    return std::min(bucket, METRICS_FRAME_BUCKETS - 1);
+  }
+
+  /**
+   * Get upper bound of a histogram bucket
+   * @param bucket bucket index
+   * @return bound in microseconds, frames in the bucket are under it
+   */
+  static uint64_t BucketBound(int bucket) {
+    if (bucket < METRICS_FRAME_SUB_BUCKETS) return bucket + 1;
+    int shift = bucket / METRICS_FRAME_SUB_BUCKETS - 1;
+    uint64_t sub = bucket % METRICS_FRAME_SUB_BUCKETS;
+    return (METRICS_FRAME_SUB_BUCKETS + sub + 1) << shift;
+  }
+
+public:
+  /**
+   * Get block being updated
+   * @return metrics block
+   */
+  static metrics_block &Get() {
+    return *s_block;
+  }
+
+  /**
+   * Set up publishing from the environment
+   * BREAKOUT_METRICS_SHM names the shared memory region (default
+   * /breakout_metrics), BREAKOUT_METRICS_FILE enables the exposition file and
+   * BREAKOUT_METRICS_INTERVAL sets its period in seconds
+   * Must be called before any other thread starts updating metrics
+   */
+  static void Init() {
+    const char *shm = getenv("BREAKOUT_METRICS_SHM");
+    Publish(shm ? shm : METRICS_DEFAULT_SHM);
+
+    const char *file = getenv("BREAKOUT_METRICS_FILE");
+    if (file) s_file = file;
+    const char *interval = getenv("BREAKOUT_METRICS_INTERVAL");
+    if (interval) s_interval = std::chrono::seconds(std::max(1, atoi(interval)));
+    s_last_write = std::chrono::steady_clock::now();
+  }
+
+  /**
+   * Move metrics into a shared memory region
+   * Stays on the process-local block if the region cannot be created, and
+   * always off Linux
+   * @param name shared memory name, starting with '/'
+   * @return true if published
+   */
+  static bool Publish(const std::string &name) {
+#ifdef __linux__
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, sizeof(metrics_block)) != 0) {
+      close(fd);
+      return false;
+    }
+    void *memory = mmap(nullptr, sizeof(metrics_block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    s_block = new (memory) metrics_block();
+    return true;
+#else
+    (void)name;
+    return false;
+#endif
+  }
+
+  /**
+   * Map a published region read-only
+   * @param name shared memory name
+   * @return metrics block, or nullptr if not published or off Linux
+   */
+  static const metrics_block *Open(const std::string &name) {
+#ifdef __linux__
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return nullptr;
+    void *memory = mmap(nullptr, sizeof(metrics_block), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return nullptr;
+
+    auto *block = static_cast<const metrics_block *>(memory);
+    return (block->magic == METRICS_MAGIC) ? block : nullptr;
+#else
+    (void)name;
+    return nullptr;
+#endif
+  }
+
+  /**
+   * Copy every field of a block
+   * @param block metrics block
+   * @return sample
+   */
+  static metrics_sample Sample(const metrics_block &block) {
+    auto load = [](const std::atomic<uint64_t> &value) { return value.load(std::memory_order_relaxed); };
+    metrics_sample sample;
+    sample.ticks = load(block.ticks);
+    sample.frames = load(block.frames);
+    for (int i = 0; i < METRICS_FRAME_BUCKETS; i++) {
+      sample.frame_time_us[i] = load(block.frame_time_us[i]);
+    }
+    sample.live_balls = load(block.live_balls);
+    sample.collision_tests = load(block.collision_tests);
+    sample.collision_tests_last_tick = load(block.collision_tests_last_tick);
+    sample.blocks_broken = load(block.blocks_broken);
+    sample.allocations = load(block.allocations);
+    sample.allocations_last_frame = load(block.allocations_last_frame);
+    sample.level_load_us = load(block.level_load_us);
+    return sample;
+  }
+
+  /**
+   * Estimate a frame time quantile from the histogram
+   * @param sample sample
+   * @param q quantile in [0, 1]
+   * @return upper bound of the bucket holding the quantile, in microseconds
+   */
+  static uint64_t FrameTimeQuantile(const metrics_sample &sample, double q) {
+    uint64_t total = 0;
+    for (uint64_t count : sample.frame_time_us) total += count;
+    if (total == 0) return 0;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_FRAME_BUCKETS; i++) {
+      seen += sample.frame_time_us[i];
+      if (seen >= q * total) return BucketBound(i);
+    }
+    return BucketBound(METRICS_FRAME_BUCKETS - 1);
+  }
+
+  /**
+   * Format sample in Prometheus text exposition format
+   * @param sample current sample
+   * @param previous sample taken the given number of seconds earlier
+   * @param seconds time between the two samples, 0 to skip rates
+   * @return exposition text
+   */
+  static std::string Format(const metrics_sample &sample, const metrics_sample &previous, double seconds) {
+    std::ostringstream out;
+    auto metric = [&](const char *name, const char *type, auto value) {
+      out << "# TYPE breakout_" << name << " " << type << "\n"
+          << "breakout_" << name << " " << value << "\n";
+    };
+
+    metric("ticks_total", "counter", sample.ticks);
+    metric("live_balls", "gauge", sample.live_balls);
+    metric("collision_tests_total", "counter", sample.collision_tests);
+    metric("collision_tests_per_tick", "gauge", sample.collision_tests_last_tick);
+    metric("blocks_broken_total", "counter", sample.blocks_broken);
+    metric("allocations_total", "counter", sample.allocations);
+    metric("allocations_per_frame", "gauge", sample.allocations_last_frame);
+    metric("level_load_seconds", "gauge", sample.level_load_us / 1e6);
+    if (seconds > 0) {
+      metric("ticks_per_second", "gauge", (sample.ticks - previous.ticks) / seconds);
+      metric("blocks_broken_per_second", "gauge", (sample.blocks_broken - previous.blocks_broken) / seconds);
+    }
+
+    out << "# TYPE breakout_frame_time_seconds histogram\n";
+    uint64_t cumulative = 0;
+    for (int i = 0; i < METRICS_FRAME_BUCKETS; i++) {
+      cumulative += sample.frame_time_us[i];
+      out << "breakout_frame_time_seconds_bucket{le=\"" << BucketBound(i) / 1e6 << "\"} " << cumulative << "\n";
+    }
+    out << "breakout_frame_time_seconds_bucket{le=\"+Inf\"} " << cumulative << "\n"
+        << "breakout_frame_time_seconds_count " << cumulative << "\n";
+
+    out << "# TYPE breakout_frame_time_quantile_seconds gauge\n";
+    for (double q : {0.5, 0.9, 0.99}) {
+      out << "breakout_frame_time_quantile_seconds{quantile=\"" << q << "\"} "
+          << FrameTimeQuantile(sample, q) / 1e6 << "\n";
+    }
+
+    return out.str();
+  }
+
+  /**
+   * Record one frame, and write the exposition file if it is due
+   * @param us frame time in microseconds
+   */
+  static void RecordFrame(uint64_t us) {
+    metrics_block &block = Get();
+    block.frame_time_us[Bucket(us)].fetch_add(1, std::memory_order_relaxed);
+    block.frames.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t allocations = block.allocations.load(std::memory_order_relaxed);
+    block.allocations_last_frame.store(allocations - s_last_allocations, std::memory_order_relaxed);
+    s_last_allocations = allocations;
+
+    if (s_file.empty()) return;
+    auto now = std::chrono::steady_clock::now();
+    if (now - s_last_write < s_interval) return;
+
+    // write then rename so a scraper never sees a partial file
+    metrics_sample sample = Sample(block);
+    double seconds = std::chrono::duration<double>(now - s_last_write).count();
+    {
+      std::ofstream file(s_file + ".tmp");
+      file << Format(sample, s_last_sample, seconds);
+    }
+    std::rename((s_file + ".tmp").c_str(), s_file.c_str());
+    s_last_sample = sample;
+    s_last_write = now;
+  }
+};
+
+/**
+ * Sets a gauge to the lifetime of a scope in microseconds
+ */
+class MetricTimer {
+private:
+  std::atomic<uint64_t> &m_gauge;                     /// gauge to set
+  std::chrono::steady_clock::time_point m_start;      /// start of scope
+
+public:
+  /**
+   * Default constructor
+   * @param gauge gauge to set
+   */
+  MetricTimer(std::atomic<uint64_t> &gauge)
+      : m_gauge(gauge), m_start(std::chrono::steady_clock::now()) {}
+
+  /**
+   * Destructor, records elapsed time
+   */
+  ~MetricTimer() {
+    auto elapsed = std::chrono::steady_clock::now() - m_start;
+    m_gauge.store(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(),
+                  std::memory_order_relaxed);
+  }
+};
+
+/**
+ * Records the lifetime of a scope as one frame
+ */
+class MetricFrame {
+private:
+  std::chrono::steady_clock::time_point m_start;  /// start of frame
+
+public:
+  /**
+   * Default constructor
+   */
+  MetricFrame() : m_start(std::chrono::steady_clock::now()) {}
+
+  /**
+   * Destructor, records frame time
+   */
+  ~MetricFrame() {
+    auto elapsed = std::chrono::steady_clock::now() - m_start;
+    Metrics::RecordFrame(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+  }
+};
+
+#ifdef BREAKOUT_METRICS
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_INIT() Metrics::Init()
+#define METRIC_ADD(name, value) Metrics::Get().name.fetch_add((value), std::memory_order_relaxed)
+#define METRIC_SET(name, value) Metrics::Get().name.store((value), std::memory_order_relaxed)
+#define METRIC_TIMER(name) MetricTimer METRICS_CONCAT(metric_timer_, __LINE__)(Metrics::Get().name)
+#define METRIC_FRAME() MetricFrame METRICS_CONCAT(metric_frame_, __LINE__)
+#else
+#define METRICS_INIT() ((void)0)
+#define METRIC_ADD(name, value) ((void)0)
+#define METRIC_SET(name, value) ((void)0)
+#define METRIC_TIMER(name) ((void)0)
+#define METRIC_FRAME() ((void)0)
+#endif
@@ -0,0 +1,37 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+
+/**
+ * Main function
+ * Reads the metrics a running game or headless sim publishes to shared
+ * memory and prints them in text exposition format
+ * Arguments: shared memory name, seconds between samples (0 to print once)
+ * @return success
+ */
+int main(int argc, char **argv) {
+  std::string name = (argc > 1) ? argv[1] : METRICS_DEFAULT_SHM;
+  int interval = (argc > 2) ? std::stoi(argv[2]) : 0;
+
+  const metrics_block *block = Metrics::Open(name);
+  if (block == nullptr) {
+    std::cerr << "No metrics published at " << name << std::endl;
+    return 1;
+  }
+
+  metrics_sample previous = Metrics::Sample(*block);
+  if (interval <= 0) {
+    std::cout << Metrics::Format(previous, previous, 0);
+    return 0;
+  }
+
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::seconds(interval));
+    metrics_sample sample = Metrics::Sample(*block);
+    std::cout << Metrics::Format(sample, previous, interval) << std::endl;
+    previous = sample;
+  }
+}
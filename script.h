@@ -0,0 +1,507 @@
+#pragma once
+
+#include "SFML/Graphics.hpp"
+#include "bodies.h"
+#include "grid.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory_resource>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+class Scheduler;
+
+/**
+ * Script class
+ * Return type of level script coroutines. A script does nothing until it
+ * is handed to a Scheduler, which then owns it.
+ */
+class Script {
+public:
+  /// where coroutine frames created on this thread are allocated, see ScriptFrames
+  inline static thread_local std::pmr::memory_resource *s_frames = nullptr;
+
+  struct promise_type {
+    Scheduler *scheduler = nullptr;  /// scheduler running the script
+    uint64_t order = 0;              /// start order, breaks ties between scripts due together
+
+    /**
+     * Allocate coroutine frame, remembering the resource in front of it
+     * @param size frame size
+     * @return frame
+     */
+    static void *operator new(std::size_t size) {
+      std::pmr::memory_resource *resource = s_frames ? s_frames : std::pmr::new_delete_resource();
+      void *block = resource->allocate(size + FRAME_HEADER, alignof(std::max_align_t));
+      *static_cast<std::pmr::memory_resource **>(block) = resource;
+      return static_cast<std::byte *>(block) + FRAME_HEADER;
+    }
+
+    /**
+     * Free coroutine frame to the resource it came from
+     * @param frame frame
+     * @param size frame size
+     */
+    static void operator delete(void *frame, std::size_t size) {
+      std::byte *block = static_cast<std::byte *>(frame) - FRAME_HEADER;
+      std::pmr::memory_resource *resource = *reinterpret_cast<std::pmr::memory_resource **>(block);
+      resource->deallocate(block, size + FRAME_HEADER, alignof(std::max_align_t));
+    }
+
+    Script get_return_object() {
+      return Script(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  typedef std::coroutine_handle<promise_type> handle;
+
+private:
+  static const std::size_t FRAME_HEADER = alignof(std::max_align_t);  /// room for the resource pointer
+
+  handle m_handle;  /// coroutine, null once handed over
+
+public:
+  /**
+   * Default constructor
+   * @param coroutine coroutine handle
+   */
+  explicit Script(handle coroutine) : m_handle(coroutine) {}
+
+  Script(const Script &) = delete;
+  Script &operator=(const Script &) = delete;
+
+  /**
+   * Move constructor
+   * @param other script to take over
+   */
+  Script(Script &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+  /**
+   * Destructor, destroys the coroutine if it never got scheduled
+   */
+  ~Script() {
+    if (m_handle) m_handle.destroy();
+  }
+
+  /**
+   * Give up ownership of the coroutine
+   * @return coroutine handle
+   */
+  handle Release() {
+    return std::exchange(m_handle, nullptr);
+  }
+};
+
+/**
+ * Allocates coroutine frames created on this thread from a resource
+ * while in scope
+ */
+class ScriptFrames {
+private:
+  std::pmr::memory_resource *m_previous;  /// resource to restore
+
+public:
+  /**
+   * Default constructor
+   * @param resource resource for new frames
+   */
+  explicit ScriptFrames(std::pmr::memory_resource *resource)
+      : m_previous(std::exchange(Script::s_frames, resource)) {}
+
+  ScriptFrames(const ScriptFrames &) = delete;
+  ScriptFrames &operator=(const ScriptFrames &) = delete;
+
+  /**
+   * Destructor, restores the previous resource
+   */
+  ~ScriptFrames() {
+    Script::s_frames = m_previous;
+  }
+};
+
+/**
+ * Scheduler class
+ * Wakes suspended scripts on the tick they asked for. Sleeping scripts sit
+ * in a min-heap by wake tick, so a tick only costs work for scripts that
+ * are actually due. Scripts due on the same tick wake in the order they
+ * were started, so a scheduler rebuilt mid-level runs them in the same
+ * order as the original.
+ */
+class Scheduler {
+private:
+  struct entry {
+    uint64_t tick;          /// tick to wake on
+    uint64_t order;         /// start order of the script, so wake order is deterministic
+    Script::handle script;  /// script to resume
+
+    bool operator>(const entry &other) const {
+      return std::tie(tick, order) > std::tie(other.tick, other.order);
+    }
+  };
+
+  typedef std::priority_queue<entry, std::pmr::vector<entry>, std::greater<entry>> queue;
+
+  std::pmr::memory_resource *m_resource;  /// allocator for the queue and script frames
+  queue m_queue;                          /// sleeping scripts by wake tick
+  uint64_t m_tick = 0;                    /// tick being run
+  uint64_t m_order = 0;                   /// scripts started so far
+
+public:
+  /**
+   * Default constructor
+   * @param resource allocator for the queue and for frames of scripts
+   *                 created through LoadScripts
+   */
+  explicit Scheduler(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : m_resource(resource), m_queue(std::greater<entry>(), std::pmr::vector<entry>(resource)) {}
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  /**
+   * Destructor, destroys scripts that are still sleeping
+   */
+  ~Scheduler() {
+    Clear();
+  }
+
+  /**
+   * Destroy every sleeping script and free the queue
+   */
+  void Clear() {
+    while (!m_queue.empty()) {
+      m_queue.top().script.destroy();
+      m_queue.pop();
+    }
+    m_queue = queue(std::greater<entry>(), std::pmr::vector<entry>(m_resource));
+    m_tick = 0;
+    m_order = 0;
+  }
+
+  /**
+   * Take ownership of a script and run it from the next call to Run
+   * @param script script to start
+   */
+  void Start(Script script) {
+    Script::handle coroutine = script.Release();
+    coroutine.promise().scheduler = this;
+    coroutine.promise().order = m_order++;
+    m_queue.push({m_tick, coroutine.promise().order, coroutine});
+  }
+
+  /**
+   * Put a script to sleep
+   * Scripts always sleep at least until the next tick
+   * @param script script to wake
+   * @param tick tick to wake on
+   */
+  void Schedule(Script::handle script, uint64_t tick) {
+    m_queue.push({std::max(tick, m_tick + 1), script.promise().order, script});
+  }
+
+  /**
+   * Resume every script that is due
+   * @param tick current tick
+   */
+  void Run(uint64_t tick) {
+    TRACE_ZONE("Scheduler::Run");
+    m_tick = tick;
+    while (!m_queue.empty() && m_queue.top().tick <= tick) {
+      Script::handle script = m_queue.top().script;
+      m_queue.pop();
+      script.resume();
+      if (script.done()) script.destroy();
+    }
+  }
+
+  /**
+   * Get tick being run
+   * @return tick
+   */
+  uint64_t GetTick() const {
+    return m_tick;
+  }
+
+  /**
+   * Get allocator for script frames
+   * @return memory resource
+   */
+  std::pmr::memory_resource *GetResource() const {
+    return m_resource;
+  }
+
+  /**
+   * Get number of sleeping scripts
+   * @return number of scripts
+   */
+  size_t Pending() const {
+    return m_queue.size();
+  }
+};
+
+/**
+ * Awaitable that sleeps until an absolute tick
+ * Carries on at once if the tick is already being run, so scripts started
+ * mid-level still act on the tick they were started on
+ */
+struct WaitUntil {
+  uint64_t tick;  /// tick to wake on
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(Script::handle script) const {
+    Scheduler *scheduler = script.promise().scheduler;
+    if (tick <= scheduler->GetTick()) return false;
+    scheduler->Schedule(script, tick);
+    return true;
+  }
+  void await_resume() const noexcept {}
+};
+
+/**
+ * Awaitable that sleeps for a number of ticks
+ */
+struct Wait {
+  uint64_t ticks;  /// ticks to sleep
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(Script::handle script) const {
+    Scheduler *scheduler = script.promise().scheduler;
+    scheduler->Schedule(script, scheduler->GetTick() + ticks);
+  }
+  void await_resume() const noexcept {}
+};
+
+/*
+ * Level scripts only act on the tick they wake on and on what is in the
+ * grid at the time, so everything they did before a tick is already in a
+ * snapshot taken at it. Each takes the tick the game starts from and skips
+ * whatever came before it, which lets Game rebuild its scripts after a
+ * rewind or in a fork without repeating or losing any event.
+ */
+
+/**
+ * Place a block once a tick is reached, if its cell is free
+ * @param grid grid of blocks
+ * @param tick tick to spawn on
+ * @param x x grid value
+ * @param y y grid value
+ * @param id tile ID
+ * @param from tick the game starts from
+ */
+inline Script SpawnBlock(Grid &grid, uint64_t tick, int x, int y, uint8_t id, uint64_t from) {
+  if (tick < from) co_return;
+  co_await WaitUntil{tick};
+  if (grid.GetTile(x, y) == 0) grid.SetTile(x, y, id);
+}
+
+/**
+ * Get where a sliding block is due after a number of steps
+ * @param x0 one end of the path
+ * @param x1 other end of the path
+ * @param step steps since the block was placed
+ * @return x grid value
+ */
+inline int SlidePosition(int x0, int x1, uint64_t step) {
+  int length = std::abs(x1 - x0);
+  if (length == 0) return x0;
+  int offset = static_cast<int>(step % (2 * length));
+  if (offset > length) offset = 2 * length - offset;
+  return (x1 >= x0) ? x0 + offset : x0 - offset;
+}
+
+/**
+ * Move a block back and forth along a row, one cell per period
+ * Each step the block moves one cell toward where its schedule puts it,
+ * see SlidePosition, so a block held up by a taken cell catches up later.
+ * The script ends once the block is broken. Started after the block was
+ * placed, it takes the block with its ID nearest to that position.
+ * @param grid grid of blocks
+ * @param start tick to start on
+ * @param period ticks per step
+ * @param x0 one end of the path
+ * @param x1 other end of the path
+ * @param y row
+ * @param id tile ID
+ * @param from tick the game starts from
+ */
+inline Script SlideBlock(Grid &grid, uint64_t start, uint64_t period, int x0, int x1, int y, uint8_t id,
+                         uint64_t from) {
+  period = std::max<uint64_t>(period, 1);
+  uint64_t step = 1;
+  int x = x0;
+  if (from <= start) {
+    co_await WaitUntil{start};
+    if (grid.GetTile(x, y) == 0) grid.SetTile(x, y, id);
+  } else {
+    step = (from - start - 1) / period + 1;
+    int due = SlidePosition(x0, x1, step - 1);
+    bool found = false;
+    for (int cell = std::min(x0, x1); cell <= std::max(x0, x1); cell++) {
+      if (grid.GetTile(cell, y) == id && (!found || std::abs(cell - due) < std::abs(x - due))) {
+        x = cell;
+        found = true;
+      }
+    }
+    if (!found) co_return;
+  }
+
+  while (x0 != x1) {
+    co_await WaitUntil{start + step * period};
+    if (grid.GetTile(x, y) != id) co_return;
+
+    int due = SlidePosition(x0, x1, step++);
+    if (due == x) continue;
+    int next = (due > x) ? x + 1 : x - 1;
+    if (grid.GetTile(next, y) != 0) continue;
+    grid.SetTile(x, y, 0);
+    grid.SetTile(next, y, id);
+    x = next;
+  }
+}
+
+/**
+ * Release rows of blocks at an interval, each one row below the last
+ * Only empty cells are filled.
+ * @param grid grid of blocks
+ * @param start tick of first row
+ * @param interval ticks between rows
+ * @param count number of rows
+ * @param row first row
+ * @param id tile ID
+ * @param from tick the game starts from
+ */
+inline Script Wave(Grid &grid, uint64_t start, uint64_t interval, int count, int row, uint8_t id, uint64_t from) {
+  for (int i = 0; i < count; i++) {
+    uint64_t tick = start + i * interval;
+    if (tick < from) continue;
+    co_await WaitUntil{tick};
+    for (int x = 0; x < grid.GetWidth(); x++) {
+      if (grid.GetTile(x, row + i) == 0) grid.SetTile(x, row + i, id);
+    }
+  }
+}
+
+/**
+ * Add a moving block once a tick is reached
+ * @param bodies moving blocks
+ * @param tick tick to spawn on
+ * @param item body to add
+ * @param from tick the game starts from
+ */
+inline Script SpawnBody(Bodies &bodies, uint64_t tick, body item, uint64_t from) {
+  if (tick < from) co_return;
+  co_await WaitUntil{tick};
+  bodies.Add(item);
+}
+
+/**
+ * Read a level script file
+ * @param filename name of script file
+ * @return file contents, empty if the file does not exist
+ */
+inline std::string ReadScripts(const std::string &filename) {
+  std::ifstream file(filename);
+  std::ostringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+/**
+ * Start scripts listed in a level script
+ * One script per line, blank lines and lines starting with '#' ignored:
+ *   spawn <tick> <x> <y> <id>
+ *   slide <start> <period> <x0> <x1> <y> <id>
+ *   wave <start> <interval> <count> <row> <id>
+ *   slider <tick> <x> <y> <width> <height> <speed> <x_min> <x_max> <id>
+ *   bar <tick> <x> <y> <length> <degrees_per_tick> <id>
+ *   debris <tick> <x> <y> <vx> <vy> <id>
+ * Moving block positions are in pixels, the rest in grid cells. Bar spin is
+ * rounded to 1/16 degree so it can come from the integer angle table.
+ * @param scripts script text, see ReadScripts
+ * @param scheduler scheduler to start scripts on, empty
+ * @param grid grid scripts act on
+ * @param bodies moving blocks scripts add to
+ * @param from tick the game starts from, events before it are skipped
+ * @return number of scripts started
+ */
+inline int StartScripts(const std::string &scripts, Scheduler &scheduler, Grid &grid, Bodies &bodies,
+                        uint64_t from = 0) {
+  ScriptFrames frames(scheduler.GetResource());
+  std::istringstream file(scripts);
+  std::string line;
+  int started = 0;
+
+  while (std::getline(file, line)) {
+    std::istringstream in(line);
+    std::string command;
+    if (!(in >> command) || command[0] == '#') continue;
+
+    uint64_t a, b;
+    int x, y, z, id;
+    float fx, fy, fw, fh, fs, fmin, fmax;
+    body item;
+    if (command == "slider" && in >> a >> fx >> fy >> fw >> fh >> fs >> fmin >> fmax >> id) {
+      item.kind = body_kind::SLIDER;
+      item.position = {ToFixed(fx), ToFixed(fy)};
+      item.half = {ToFixed(fw / 2), ToFixed(fh / 2)};
+      item.velocity = {ToFixed(fs), 0};
+      item.path_min = ToFixed(fmin);
+      item.path_max = ToFixed(fmax);
+      item.id = id;
+      scheduler.Start(SpawnBody(bodies, a, item, from));
+    } else if (command == "bar" && in >> a >> fx >> fy >> fw >> fs >> id) {
+      item.kind = body_kind::ROTATOR;
+      item.position = {ToFixed(fx), ToFixed(fy)};
+      item.half = {ToFixed(fw / 2), ToFixed(BLOCK_HALF_SIZE)};
+      item.spin = static_cast<int32_t>(std::lround(fs * ANGLE_STEPS_PER_DEGREE));
+      item.id = id;
+      scheduler.Start(SpawnBody(bodies, a, item, from));
+    } else if (command == "debris" && in >> a >> fx >> fy >> fw >> fh >> id) {
+      item.kind = body_kind::DEBRIS;
+      item.position = {ToFixed(fx), ToFixed(fy)};
+      item.half = {ToFixed(BLOCK_HALF_SIZE), ToFixed(BLOCK_HALF_SIZE)};
+      item.velocity = {ToFixed(fw), ToFixed(fh)};
+      item.id = id;
+      scheduler.Start(SpawnBody(bodies, a, item, from));
+    } else if (command == "spawn" && in >> a >> x >> y >> id) {
+      scheduler.Start(SpawnBlock(grid, a, x, y, id, from));
+    } else if (command == "slide" && in >> a >> b >> x >> z >> y >> id) {
+      scheduler.Start(SlideBlock(grid, a, b, x, z, y, id, from));
+    } else if (command == "wave" && in >> a >> b >> x >> y >> id) {
+      scheduler.Start(Wave(grid, a, b, x, y, id, from));
+    } else {
+      continue;
+    }
+    started++;
+  }
+
+  return started;
+}
+
+/**
+ * Get name of the script file that goes with a level file
+ * @param level name of level file
+ * @return level name with its extension replaced by .script
+ */
+inline std::string ScriptFileFor(const std::string &level) {
+  size_t dot = level.find_last_of('.');
+  size_t slash = level.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return level + ".script";
+  return level.substr(0, dot) + ".script";
+}
@@ -0,0 +1,96 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "SFML/Graphics.hpp"
+
+#include "constants.h"
+#include "game.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "trace.h"
+
+/**
+ * Paddle policy that keeps the lowest ball at an offset from the paddle center
+ * @param offset ball offset from paddle center, in pixels
+ * @return policy
+ */
+paddle_policy TrackLowest(float offset) {
+  return [offset](const Game &game) {
+    const game_ball *lowest = nullptr;
+    for (const game_ball &ball : game.GetBalls()) {
+      if (lowest == nullptr || ball.GetPosition().y > lowest->GetPosition().y) {
+        lowest = &ball;
+      }
+    }
+    if (lowest == nullptr) return static_cast<float>(WINDOW_HALF_WIDTH);
+    return lowest->GetPosition().x - offset;
+  };
+}
+
+/**
+ * Main function
+ * Runs a level headless, then forks the state and plays it out with
+ * different paddle offsets in parallel
+ * Arguments: level file, warmup ticks, number of forks, fork ticks
+ * Trace builds write breakout_sim.trace.json on exit
+ * Fixed point builds print the same state hashes on every platform
+ * Prints memory use of the warmup game, for setting budgets on large levels
+ * @return success
+ */
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Needs level file name as program argument." << std::endl;
+    return 1;
+  }
+
+  METRICS_INIT();
+  TRACE_THREAD("main");
+  std::string level(argv[1]);
+  uint64_t warmup = (argc > 2) ? std::stoull(argv[2]) : 10 * FRAME_RATE;
+  int forks = (argc > 3) ? std::stoi(argv[3]) : 9;
+  uint64_t ticks = (argc > 4) ? std::stoull(argv[4]) : 60 * FRAME_RATE;
+
+  // play the level up to the fork point
+  Game game(level);
+  paddle_policy centered = TrackLowest(0);
+  while (game.GetTick() < warmup && !game.Lost() && !game.Won()) {
+    METRIC_FRAME();
+    game.Step(centered(game));
+  }
+
+  std::cout << game.GetMemory().Report();
+
+  auto start = std::chrono::steady_clock::now();
+  Snapshot origin;
+  game.Save(origin);
+  auto saved = std::chrono::steady_clock::now();
+  std::cout << "Forking at tick " << game.GetTick() << ": " << origin.Size() << " bytes, saved in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(saved - start).count() << " us" << std::endl;
+
+  // one alternative per paddle offset across the paddle
+  std::vector<paddle_policy> policies;
+  std::vector<float> offsets;
+  for (int i = 0; i < forks; i++) {
+    float offset = (forks > 1) ? (i * 2.0f / (forks - 1) - 1.0f) * (PLAYER_HALF_WIDTH - BALL_RADIUS) : 0;
+    offsets.push_back(offset);
+    policies.push_back(TrackLowest(offset));
+  }
+
+  std::vector<Snapshot> results = ForkAndRun(origin, policies, ticks, game.GetScript());
+  auto finished = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < forks; i++) {
+    Game result(results[i]);
+    std::cout << "offset " << offsets[i]
+              << ": tick " << result.GetTick()
+              << ", balls " << result.GetBalls().size()
+              << ", blocks left " << result.GetGrid().BlocksRemaining()
+              << ", state " << std::hex << results[i].Hash() << std::dec << std::endl;
+  }
+  std::cout << forks << " forks in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(finished - saved).count() << " ms" << std::endl;
+
+  TRACE_FLUSH("breakout_sim.trace.json");
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * Fixed part of a snapshot, followed in the buffer by the balls, the moving
+ * blocks and then the grid tile IDs
+ */
+struct snapshot_header {
+  uint64_t tick = 0;        /// simulation tick
+  uint64_t rng = 0;         /// random number generator state
+  float paddle_x = 0;       /// player position
+  uint32_t ball_count = 0;  /// number of balls following the header
+  uint16_t grid_width = 0;  /// grid width in tiles
+  uint16_t grid_height = 0; /// grid height in tiles
+  uint32_t body_count = 0;  /// number of moving blocks following the balls
+};
+
+static_assert(sizeof(snapshot_header) == 32, "snapshot header must not have implicit padding");
+
+/**
+ * Whole simulation state in one flat buffer
+ * Copying a snapshot is a single memcpy, and saving into an existing
+ * snapshot reuses its buffer.
+ */
+class Snapshot {
+private:
+  std::vector<std::byte> m_buffer;  /// header, balls, tiles
+
+public:
+  /**
+   * Resize buffer, keeping capacity
+   * @param size size in bytes
+   * @return start of buffer
+   */
+  std::byte *Resize(size_t size) {
+    m_buffer.resize(size);
+    return m_buffer.data();
+  }
+
+  /**
+   * Get start of buffer
+   * @return start of buffer
+   */
+  const std::byte *Data() const {
+    return m_buffer.data();
+  }
+
+  /**
+   * Get size of buffer
+   * @return size in bytes
+   */
+  size_t Size() const {
+    return m_buffer.size();
+  }
+
+  /**
+   * Check if snapshot holds a state
+   * @return true if nothing was saved
+   */
+  bool Empty() const {
+    return m_buffer.empty();
+  }
+
+  /**
+   * Read header
+   * @return header
+   */
+  snapshot_header GetHeader() const {
+    snapshot_header header;
+    std::memcpy(&header, m_buffer.data(), sizeof(header));
+    return header;
+  }
+
+  /**
+   * Hash whole state (FNV-1a), equal states give equal hashes
+   * Used to check replays and forks against each other
+   * @return hash
+   */
+  uint64_t Hash() const {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (std::byte b : m_buffer) {
+      hash = (hash ^ static_cast<uint8_t>(b)) * 0x100000001B3ULL;
+    }
+    return hash;
+  }
+};
+
+/**
+ * Ring buffer of the most recent snapshots, for rewinding
+ * Slots are reused so steady-state saving does not allocate.
+ */
+class RewindBuffer {
+private:
+  std::vector<Snapshot> m_slots;  /// snapshot storage
+  size_t m_head = 0;              /// slot the next save goes to
+  size_t m_count = 0;             /// number of valid slots
+
+public:
+  /**
+   * Default constructor
+   * @param capacity number of snapshots kept
+   */
+  RewindBuffer(size_t capacity) : m_slots(capacity) {}
+
+  /**
+   * Get slot for the next save, overwriting the oldest when full
+   * @return snapshot to save into
+   */
+  Snapshot &Push() {
+    Snapshot &slot = m_slots[m_head];
+    m_head = (m_head + 1) % m_slots.size();
+    m_count = std::min(m_count + 1, m_slots.size());
+    return slot;
+  }
+
+  /**
+   * Take most recent snapshot off the buffer
+   * @return snapshot, or nullptr if the buffer is empty
+   */
+  const Snapshot *Pop() {
+    if (m_count == 0) return nullptr;
+    m_head = (m_head + m_slots.size() - 1) % m_slots.size();
+    m_count--;
+    return &m_slots[m_head];
+  }
+
+  /**
+   * Drop all snapshots
+   */
+  void Clear() {
+    m_head = 0;
+    m_count = 0;
+  }
+};
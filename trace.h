@@ -0,0 +1,279 @@
+#pragma once
+
+/**
+ * Scoped trace zones written out as Chrome/Perfetto trace-event JSON
+ * TRACE_ZONE marks the rest of the enclosing scope, TRACE_THREAD names the
+ * calling thread and TRACE_FLUSH writes everything recorded so far. All of
+ * them compile to nothing unless BREAKOUT_TRACE is defined, which the build
+ * only does outside release configurations.
+ */
+
+#ifdef BREAKOUT_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Events kept per thread, older events are overwritten. Zones mark
+/// subsystems, never single balls, so a tick records about ten events and
+/// the ring holds thousands of frames whatever the ball count.
+const uint64_t TRACE_BUFFER_EVENTS = 1 << 16;
+
+/**
+ * One completed zone
+ */
+struct trace_event {
+  const char *name = nullptr; /// zone name, must be a string literal
+  uint64_t start_ns = 0;      /// start time since trace epoch
+  uint64_t duration_ns = 0;   /// zone length
+};
+
+/**
+ * Ring slot holding one event
+ * Fields are relaxed atomics so a flush may copy a slot while its thread
+ * overwrites it; such torn copies are detected and dropped.
+ */
+struct trace_slot {
+  std::atomic<const char *> name{nullptr};
+  std::atomic<uint64_t> start_ns{0};
+  std::atomic<uint64_t> duration_ns{0};
+};
+
+/**
+ * Per-thread ring of events
+ * Only the owning thread writes. Like a seqlock, it bumps claimed before
+ * overwriting a slot and publishes written after, so a flushing thread can
+ * read without locking and tell which copies to trust.
+ */
+struct trace_buffer {
+  std::vector<trace_slot> slots = std::vector<trace_slot>(TRACE_BUFFER_EVENTS);
+  std::atomic<uint64_t> claimed{0}; /// events started, slots up to here may be in flux
+  std::atomic<uint64_t> written{0}; /// events finished
+  uint32_t thread_id = 0;           /// small ID for the trace file
+  std::string thread_name;          /// name shown in the viewer
+};
+
+/**
+ * Trace class
+ * Buffers outlive their threads so a flush still sees their events, and a
+ * finished thread's buffer goes back to a free list for the next thread.
+ * Workers started again for every job batch therefore reuse a fixed set of
+ * buffers and keep one track each in the viewer.
+ */
+class Trace {
+private:
+  /**
+   * Hands the calling thread's buffer back when the thread exits
+   */
+  struct buffer_owner {
+    trace_buffer *buffer = nullptr;
+
+    ~buffer_owner() {
+      if (buffer != nullptr) Release(buffer);
+    }
+  };
+
+  inline static std::mutex s_mutex;                            /// guards s_buffers and s_free
+  inline static std::vector<std::unique_ptr<trace_buffer>> s_buffers;
+  inline static std::vector<trace_buffer *> s_free;            /// buffers of finished threads
+  inline static const auto s_epoch = std::chrono::steady_clock::now();
+
+  /**
+   * Take a buffer for the calling thread
+   * Prefers a free buffer last used under the same name, then the most
+   * recently freed one, and only registers a new buffer if none are free.
+   * @param name thread name, or nullptr to keep the buffer's name
+   * @return buffer
+   */
+  static trace_buffer *Acquire(const std::string *name) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto found = s_free.end();
+    if (name != nullptr) {
+      found = std::find_if(s_free.begin(), s_free.end(),
+                           [&](const trace_buffer *buffer) { return buffer->thread_name == *name; });
+    }
+    if (found == s_free.end() && !s_free.empty()) found = s_free.end() - 1;
+
+    trace_buffer *buffer;
+    if (found != s_free.end()) {
+      buffer = *found;
+      s_free.erase(found);
+    } else {
+      s_buffers.push_back(std::make_unique<trace_buffer>());
+      buffer = s_buffers.back().get();
+      buffer->thread_id = s_buffers.size() - 1;
+      buffer->thread_name = "thread " + std::to_string(buffer->thread_id);
+    }
+    if (name != nullptr) buffer->thread_name = *name;
+    return buffer;
+  }
+
+  /**
+   * Get the calling thread's buffer owner
+   * @return owner, holding nullptr until the thread traces
+   */
+  static buffer_owner &Owner() {
+    thread_local buffer_owner owner;
+    return owner;
+  }
+
+  /**
+   * Return a finished thread's buffer to the free list
+   * @param buffer buffer
+   */
+  static void Release(trace_buffer *buffer) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_free.push_back(buffer);
+  }
+
+public:
+  /**
+   * Get buffer of the calling thread, taking one on first use
+   * @return buffer
+   */
+  static trace_buffer &Local() {
+    buffer_owner &owner = Owner();
+    if (owner.buffer == nullptr) owner.buffer = Acquire(nullptr);
+    return *owner.buffer;
+  }
+
+  /**
+   * Get time since trace epoch
+   * @return nanoseconds
+   */
+  static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+  }
+
+  /**
+   * Record a completed zone on the calling thread
+   * @param name zone name
+   * @param start_ns start time
+   * @param end_ns end time
+   */
+  static void Record(const char *name, uint64_t start_ns, uint64_t end_ns) {
+    trace_buffer &buffer = Local();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    trace_slot &slot = buffer.slots[index % TRACE_BUFFER_EVENTS];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+    buffer.written.store(index + 1, std::memory_order_release);
+  }
+
+  /**
+   * Name the calling thread in the trace
+   * @param name thread name
+   */
+  static void NameThread(const std::string &name) {
+    buffer_owner &owner = Owner();
+    if (owner.buffer == nullptr) {
+      owner.buffer = Acquire(&name);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(s_mutex);
+    owner.buffer->thread_name = name;
+  }
+
+  /**
+   * Write every thread's recorded events as trace-event JSON
+   * Events a thread overwrites while being copied are dropped.
+   * @param filename name of file
+   * @return true if written
+   */
+  static bool Write(const std::string &filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) return false;
+
+    // microseconds to the nanosecond, default formatting keeps six digits
+    // and merges every zone of a frame after a couple of minutes
+    file << std::fixed << std::setprecision(3);
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() {
+      if (!first) file << ",\n";
+      first = false;
+    };
+
+    std::vector<trace_event> events;
+    for (const auto &buffer : s_buffers) {
+      separator();
+      file << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->thread_id
+           << R"(,"args":{"name":")" << buffer->thread_name << "\"}}";
+
+      uint64_t end = buffer->written.load(std::memory_order_acquire);
+      uint64_t begin = (end > TRACE_BUFFER_EVENTS) ? end - TRACE_BUFFER_EVENTS : 0;
+      events.clear();
+      for (uint64_t i = begin; i < end; i++) {
+        const trace_slot &slot = buffer->slots[i % TRACE_BUFFER_EVENTS];
+        events.push_back({slot.name.load(std::memory_order_relaxed),
+                          slot.start_ns.load(std::memory_order_relaxed),
+                          slot.duration_ns.load(std::memory_order_relaxed)});
+      }
+
+      // a copy that saw any new field also sees the claim made before it, so
+      // anything one buffer behind the claims may be torn
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t after = buffer->claimed.load(std::memory_order_relaxed);
+      uint64_t valid = (after > TRACE_BUFFER_EVENTS) ? after - TRACE_BUFFER_EVENTS : 0;
+      for (uint64_t i = std::max(begin, valid); i < end; i++) {
+        const trace_event &event = events[i - begin];
+        separator();
+        file << R"({"name":")" << event.name << R"(","ph":"X","pid":1,"tid":)" << buffer->thread_id
+             << ",\"ts\":" << event.start_ns / 1000.0 << ",\"dur\":" << event.duration_ns / 1000.0 << "}";
+      }
+    }
+
+    file << "\n]}\n";
+    return true;
+  }
+};
+
+/**
+ * Records the lifetime of a scope as a trace event
+ */
+class TraceZone {
+private:
+  const char *m_name;  /// zone name
+  uint64_t m_start;    /// start time
+
+public:
+  /**
+   * Default constructor
+   * @param name zone name, must be a string literal
+   */
+  TraceZone(const char *name) : m_name(name), m_start(Trace::Now()) {}
+
+  /**
+   * Destructor, records the zone
+   */
+  ~TraceZone() {
+    Trace::Record(m_name, m_start, Trace::Now());
+  }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#define TRACE_THREAD(name) Trace::NameThread(name)
+#define TRACE_FLUSH(filename) Trace::Write(filename)
+
+#else
+
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#define TRACE_FLUSH(filename) ((void)0)
+
+#endif